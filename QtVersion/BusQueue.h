@@ -0,0 +1,161 @@
+#ifndef BUSQUEUE_H
+#define BUSQUEUE_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Ordering core of ModbusBus: priority classes over one serial port
+ *
+ * Kept free of Qt so the host build can check it (host/BusQueueCheck.cpp).
+ *
+ * Entries leave most urgent class first, oldest first within a class.
+ * Writes to overlapping ranges of the same device and register type are
+ * never reordered:
+ * - an older queued write that a new write fully covers is dropped, and
+ *   the new write takes the more urgent class of the two
+ * - older queued writes that only partly overlap the new write (or a
+ *   write promoted because of it) and sit in a less urgent class are
+ *   promoted into the new write's class, ahead of it
+ *
+ * Reads are never dropped or promoted.
+ *
+ * @tparam Payload Caller data carried with each entry (data unit, callback)
+ */
+template <typename Payload>
+class BusQueue
+{
+public:
+    static constexpr int kClasses = 3;  // matches ModbusBus::PriorityCount
+
+    struct Entry
+    {
+        bool write{ false };
+        int server{ 0 };
+        int type{ 0 };       // register type; only equal types can overlap
+        int start{ 0 };
+        int count{ 0 };
+        int priority{ 0 };   // 0 = most urgent
+        std::uint64_t seq{ 0 };  // enqueue order, set by push()
+        Payload payload{};
+    };
+
+    /**
+     * @brief Queue @p e, dropping and promoting older writes as needed
+     *
+     * @param onDrop Called as onDrop(newer, older) for each dropped write,
+     *               before it is discarded
+     * @return Number of writes dropped
+     */
+    template <typename OnDrop>
+    int push(Entry e, OnDrop onDrop)
+    {
+        e.seq = m_nextSeq++;
+        int dropped = 0;
+
+        if (e.write) {
+            // Fully covered older writes carry nothing the new one does not
+            for (auto& q : m_queue) {
+                for (auto it = q.begin(); it != q.end();) {
+                    if (sameTarget(*it, e) && it->start >= e.start
+                        && it->start + it->count <= e.start + e.count) {
+                        if (it->priority < e.priority)
+                            e.priority = it->priority;
+                        onDrop(e, *it);
+                        it = q.erase(it);
+                        ++dropped;
+                    }
+                    else {
+                        ++it;
+                    }
+                }
+            }
+
+            // Partly overlapping older writes must still go out first.
+            // Repeat until nothing moves, so a chain of overlaps moves together.
+            std::vector<Entry> moved;
+            bool again = true;
+            while (again) {
+                again = false;
+                for (int c = e.priority + 1; c < kClasses; ++c) {
+                    auto& q = m_queue[c];
+                    for (auto it = q.begin(); it != q.end();) {
+                        if (mustPrecede(*it, e, moved)) {
+                            moved.push_back(std::move(*it));
+                            it = q.erase(it);
+                            again = true;
+                        }
+                        else {
+                            ++it;
+                        }
+                    }
+                }
+            }
+            for (Entry& m : moved) {
+                m.priority = e.priority;
+                insertInOrder(m_queue[e.priority], std::move(m));
+            }
+        }
+
+        m_queue[e.priority].push_back(std::move(e));
+        return dropped;
+    }
+
+    /** @brief Take the next entry to send; false if the queue is empty */
+    bool pop(Entry& out)
+    {
+        for (auto& q : m_queue) {
+            if (!q.empty()) {
+                out = std::move(q.front());
+                q.erase(q.begin());
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int size() const
+    {
+        int n = 0;
+        for (const auto& q : m_queue)
+            n += int(q.size());
+        return n;
+    }
+
+private:
+    std::vector<Entry> m_queue[kClasses];
+    std::uint64_t m_nextSeq{ 0 };
+
+    static bool sameTarget(const Entry& a, const Entry& b)
+    {
+        return a.write && b.write && a.server == b.server && a.type == b.type;
+    }
+
+    static bool overlaps(const Entry& a, const Entry& b)
+    {
+        return sameTarget(a, b) && a.start < b.start + b.count && b.start < a.start + a.count;
+    }
+
+    // w is older than e, so it must precede e if they overlap; it must also
+    // precede any already-moved write that is newer than it and overlaps it
+    static bool mustPrecede(const Entry& w, const Entry& e, const std::vector<Entry>& moved)
+    {
+        if (overlaps(w, e))
+            return true;
+        for (const Entry& m : moved)
+            if (m.seq > w.seq && overlaps(w, m))
+                return true;
+        return false;
+    }
+
+    static void insertInOrder(std::vector<Entry>& q, Entry e)
+    {
+        auto it = q.begin();
+        while (it != q.end() && it->seq < e.seq)
+            ++it;
+        q.insert(it, std::move(e));
+    }
+};
+
+#endif // BUSQUEUE_H
@@ -10,9 +10,9 @@
  * 1. Lock state mutex to prevent race conditions
  * 2. Record previous state for recovery after E-stop cleared
  * 3. IMMEDIATELY save counter to disk (data protection)
- * 4. Turn red light ON, yellow/green OFF
- * 5. Turn OFF all motor digital outputs
- * 6. Activate E-stop output signal
+ * 4. Turn OFF all motor digital outputs
+ * 5. Turn red light ON, yellow/green OFF
+ * 6. Activate E-stop output signal (4-6 sent as one coil frame)
  * 7. Stop counter timer
  * 8. Update UI indicators
  * 
@@ -36,23 +36,28 @@ void MainWindow::stateEstop()
 		m_countersSinceLastWrite = 0;
 	}
 
-	//Set light to red
-	writeDigitalOutput(m_redLightDigitalOutAddress, 1);
-	writeDigitalOutput(m_yellowLightDigitalOutAddress, 0);
-	writeDigitalOutput(m_greenLightDigitalOutAddress, 0);
-
+	// Start E-STOP-to-motors-off measurement (reported by reportEstopMotorsOff)
+	m_estopTimer.start();
 
 	//Set motor output off
-	writeDigitalOutput(m_motor1DigitalOutAddress, 0);
-	writeDigitalOutput(m_motor2DigitalOutAddress, 0);
-	writeDigitalOutput(m_motor3DigitalOutAddress, 0);
-	writeDigitalOutput(m_motor4DigitalOutAddress, 0);
-	writeDigitalOutput(m_motor5DigitalOutAddress, 0);
-	writeDigitalOutput(m_motor6DigitalOutAddress, 0);
-    writeDigitalOutput(m_motor8DigitalOutAddress, 0);
+	setDigitalOutput(m_motor1DigitalOutAddress, 0);
+	setDigitalOutput(m_motor2DigitalOutAddress, 0);
+	setDigitalOutput(m_motor3DigitalOutAddress, 0);
+	setDigitalOutput(m_motor4DigitalOutAddress, 0);
+	setDigitalOutput(m_motor5DigitalOutAddress, 0);
+	setDigitalOutput(m_motor6DigitalOutAddress, 0);
+	setDigitalOutput(m_motor8DigitalOutAddress, 0);
+
+	//Set light to red
+	setDigitalOutput(m_redLightDigitalOutAddress, 1);
+	setDigitalOutput(m_yellowLightDigitalOutAddress, 0);
+	setDigitalOutput(m_greenLightDigitalOutAddress, 0);
 
 	//Set EStop output on
-	writeDigitalOutput(m_EStopOutDigitalOutAddress, 1);
+	setDigitalOutput(m_EStopOutDigitalOutAddress, 1);
+
+	//Motors, lights and EStop output go out in a single FC15 frame
+	commitDigitalOutputs();
 
 	//stop timer and reset
 	timerMotors.stop();
@@ -0,0 +1,158 @@
+#include "ModbusBus.h"
+#include <QDebug>
+
+static const char* const kPriorityNames[ModbusBus::PriorityCount] = { "Safety", "Poll", "Normal" };
+
+ModbusBus::ModbusBus(QSharedPointer<QModbusClient> client, QObject* parent)
+    : QObject(parent), m_client(client)
+{
+    connect(&m_statsTimer, &QTimer::timeout, this, &ModbusBus::logStatistics);
+    setStatisticsInterval(10 * 60 * 1000);  // every 10 minutes
+}
+
+void ModbusBus::sendWrite(const QModbusDataUnit& unit, int serverAddress, Priority priority, Callback done)
+{
+    enqueue(true, unit, serverAddress, priority, std::move(done));
+}
+
+void ModbusBus::sendRead(const QModbusDataUnit& unit, int serverAddress, Priority priority, Callback done)
+{
+    enqueue(false, unit, serverAddress, priority, std::move(done));
+}
+
+int ModbusBus::queueDepth() const
+{
+    return m_queue.size();
+}
+
+void ModbusBus::enqueue(bool write, const QModbusDataUnit& unit, int serverAddress, Priority priority, Callback done)
+{
+    Queue::Entry e;
+    e.write = write;
+    e.server = serverAddress;
+    e.type = int(unit.registerType());
+    e.start = unit.startAddress();
+    e.count = int(unit.valueCount());
+    e.priority = priority;
+    e.payload.unit = unit;
+    e.payload.done = std::move(done);
+    e.payload.queued.start();
+
+    // A superseded write's enqueue time is kept, so latency reflects how
+    // long the caller has actually been waiting for that register
+    m_dropped += m_queue.push(std::move(e), [](Queue::Entry& newer, const Queue::Entry& older) {
+        if (older.payload.queued.msecsSinceReference() < newer.payload.queued.msecsSinceReference())
+            newer.payload.queued = older.payload.queued;
+    });
+
+    const int depth = queueDepth();
+    if (depth > m_maxDepth)
+        m_maxDepth = depth;
+    pump();
+}
+
+void ModbusBus::pump()
+{
+    if (m_busy)
+        return;
+
+    Queue::Entry t;
+    while (m_queue.pop(t)) {
+        if (!m_client || m_client->state() != QModbusDevice::ConnectedState) {
+            qWarning() << "Modbus bus not connected - dropping" << kPriorityNames[t.priority]
+                       << (t.write ? "write" : "read") << "to device" << t.server;
+            fail(t);
+            continue;
+        }
+
+        QModbusReply* reply = t.write ? m_client->sendWriteRequest(t.payload.unit, t.server)
+                                      : m_client->sendReadRequest(t.payload.unit, t.server);
+        if (!reply) {
+            qWarning() << "Modbus request failed:" << m_client->errorString();
+            fail(t);
+            continue;
+        }
+        if (reply->isFinished()) {
+            // Broadcast or immediate failure - nothing to wait for
+            finish(reply, t);
+            continue;
+        }
+
+        m_busy = true;
+        connect(reply, &QModbusReply::finished, this, [this, reply, t]() {
+            m_busy = false;
+            finish(reply, t);
+            pump();
+        });
+        return;
+    }
+}
+
+void ModbusBus::finish(QModbusReply* reply, const Queue::Entry& t)
+{
+    recordLatency(Priority(t.priority), t.payload.queued.elapsed());
+    if (t.payload.done)
+        t.payload.done(reply);
+    reply->deleteLater();
+}
+
+/**
+ * @brief Report a transaction that never reached the wire
+ *
+ * The callback runs from the event loop, so a caller that retries from
+ * its callback cannot recurse back into pump().
+ */
+void ModbusBus::fail(const Queue::Entry& t)
+{
+    if (!t.payload.done)
+        return;
+    QMetaObject::invokeMethod(this, [done = t.payload.done]() { done(nullptr); }, Qt::QueuedConnection);
+}
+
+void ModbusBus::recordLatency(Priority priority, qint64 ms)
+{
+    int bucket = 0;
+    while (bucket < LATENCY_BUCKETS - 1 && ms > kBucketLimitMs[bucket])
+        ++bucket;
+    ++m_latency[priority][bucket];
+    if (ms > m_latencyMaxMs[priority])
+        m_latencyMaxMs[priority] = ms;
+}
+
+void ModbusBus::setStatisticsInterval(int ms)
+{
+    m_statsTimer.stop();
+    if (ms > 0)
+        m_statsTimer.start(ms);
+}
+
+void ModbusBus::logStatistics() const
+{
+    qInfo() << "Modbus bus: queue depth" << queueDepth() << "peak" << m_maxDepth
+            << "superseded writes dropped" << m_dropped;
+
+    QString header = "  latency ms  ";
+    for (int b = 0; b < LATENCY_BUCKETS - 1; ++b)
+        header += QString("<=%1 ").arg(kBucketLimitMs[b]).leftJustified(7);
+    header += QString(">%1").arg(kBucketLimitMs[LATENCY_BUCKETS - 2]);
+    qInfo().noquote() << header;
+
+    for (int p = 0; p < PriorityCount; ++p) {
+        QString line = QString("  %1").arg(kPriorityNames[p]).leftJustified(14);
+        for (int b = 0; b < LATENCY_BUCKETS; ++b)
+            line += QString::number(m_latency[p][b]).leftJustified(7);
+        line += QString(" max %1").arg(m_latencyMaxMs[p]);
+        qInfo().noquote() << line;
+    }
+}
+
+void ModbusBus::resetStatistics()
+{
+    m_maxDepth = queueDepth();
+    m_dropped = 0;
+    for (int p = 0; p < PriorityCount; ++p) {
+        for (int b = 0; b < LATENCY_BUCKETS; ++b)
+            m_latency[p][b] = 0;
+        m_latencyMaxMs[p] = 0;
+    }
+}
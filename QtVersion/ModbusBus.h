@@ -0,0 +1,98 @@
+#ifndef MODBUSBUS_H
+#define MODBUSBUS_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include <QModbusClient>
+#include <QModbusDataUnit>
+#include <functional>
+#include "BusQueue.h"
+
+/**
+ * @brief Prioritised transaction scheduler for one Modbus RTU serial port
+ *
+ * Every request for a port goes through its bus. Only one transaction is
+ * handed to the QModbusClient at a time, so the next one on the wire is
+ * always the most urgent one waiting rather than whatever Qt queued first.
+ *
+ * Priority classes (lower value goes first):
+ * - Safety: E-stop and other motor shutdown writes
+ * - Poll:   discrete input reads (E-stop, start/stop buttons)
+ * - Normal: speed, light and buzzer writes
+ *
+ * Writes to overlapping ranges of the same device and register type are
+ * never reordered (see BusQueue): a queued write that a newer write fully
+ * covers is dropped, and the newer one inherits the more urgent of the two
+ * classes; a queued write that only partly overlaps a more urgent newer
+ * write is promoted to go just ahead of it. Dropped writes never call
+ * their callback.
+ *
+ * Statistics: current and peak queue depth, dropped write count and a
+ * per-class enqueue-to-reply latency histogram, logged periodically.
+ *
+ * Thread Safety: Not thread-safe - use from the thread that owns the client
+ */
+class ModbusBus : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Priority
+    {
+        Safety = 0,
+        Poll = 1,
+        Normal = 2,
+        PriorityCount
+    };
+
+    // Called once the reply has finished; the bus deletes the reply afterwards.
+    // Called with nullptr (from the event loop) if the request could not be sent.
+    using Callback = std::function<void(QModbusReply* reply)>;
+
+    explicit ModbusBus(QSharedPointer<QModbusClient> client, QObject* parent = nullptr);
+
+    void sendWrite(const QModbusDataUnit& unit, int serverAddress, Priority priority, Callback done = {});
+    void sendRead(const QModbusDataUnit& unit, int serverAddress, Priority priority, Callback done);
+
+    int queueDepth() const;
+    int maxQueueDepth() const { return m_maxDepth; }
+    int droppedWrites() const { return m_dropped; }
+
+    void setStatisticsInterval(int ms);  // 0 disables the periodic log
+    void logStatistics() const;
+    void resetStatistics();
+
+private:
+    struct Transaction
+    {
+        QModbusDataUnit unit;
+        Callback done;
+        QElapsedTimer queued;  // Started on enqueue, read on reply
+    };
+    using Queue = BusQueue<Transaction>;
+    static_assert(PriorityCount == Queue::kClasses, "BusQueue class count must match Priority");
+
+    // Latency histogram upper bounds (ms); the last bucket is everything above
+    static constexpr int LATENCY_BUCKETS = 8;
+    static constexpr int kBucketLimitMs[LATENCY_BUCKETS - 1]{ 5, 10, 20, 50, 100, 200, 500 };
+
+    QSharedPointer<QModbusClient> m_client;
+    Queue m_queue;
+    bool m_busy{ false };
+
+    int m_maxDepth{ 0 };
+    int m_dropped{ 0 };
+    quint32 m_latency[PriorityCount][LATENCY_BUCKETS]{};
+    qint64 m_latencyMaxMs[PriorityCount]{};
+    QTimer m_statsTimer;
+
+    void enqueue(bool write, const QModbusDataUnit& unit, int serverAddress, Priority priority, Callback done);
+    void pump();
+    void finish(QModbusReply* reply, const Queue::Entry& t);
+    void fail(const Queue::Entry& t);
+    void recordLatency(Priority priority, qint64 ms);
+};
+
+#endif // MODBUSBUS_H
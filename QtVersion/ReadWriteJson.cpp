@@ -683,6 +683,8 @@ void MainWindow::readCOMPorts()
                 else if (COMObj["name"].toString() == "InputCom")
                 {
                     m_inputPortName = COMObj["Port"].toString();
+                    if (COMObj.contains("PollMinMs"))
+                        m_inputPollMinMs = COMObj["PollMinMs"].toInt(m_inputPollMinMs);
                 }
                 else
                     qInfo() << "No COM Name Matched";
@@ -700,6 +702,7 @@ void MainWindow::writeCOMPorts()
     COMArr.append(COMObj);
     COMObj["name"] = "InputCom";
     COMObj["Port"] = m_inputPortName;
+    COMObj["PollMinMs"] = m_inputPollMinMs;
     COMArr.append(COMObj);
 
     QJsonObject myObj;
@@ -141,8 +141,7 @@ void ReadWriteModbus::handleDIReplyFinished()
             //const QString entry = tr("Address: %1, Value: %2").arg(unit.startAddress() + i)
             //                          .arg(QString::number(unit.value(i), unit.registerType() <= QModbusDataUnit::Coils ? 10 : 16));
             //qDebug() << entry;
-            QModbusDataUnit result = reply->result();
-            bool coilStatus = result.value(i); // Get the value as a bool
+            bool coilStatus = unit.value(i); // Get the value as a bool
             if (coilStatus != inputCache[i])
                         {
                             emit inputChanged(i, coilStatus);
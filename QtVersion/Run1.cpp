@@ -16,19 +16,22 @@ void MainWindow::stateRun1()
 	timerCounter.start(counterTimerInterval * 1000);
 
 	//Set motors output on - plus extra motors if needed
-	writeDigitalOutput(m_motor1DigitalOutAddress, 1);
-	writeDigitalOutput(m_motor2DigitalOutAddress, 1);
-	writeDigitalOutput(m_motor3DigitalOutAddress, 1);
-	writeDigitalOutput(m_motor4DigitalOutAddress, 1);
-	writeDigitalOutput(m_motor5DigitalOutAddress, 1);
-	writeDigitalOutput(m_motor6DigitalOutAddress, 1);
-    writeDigitalOutput(m_motor8DigitalOutAddress, 1);
+	setDigitalOutput(m_motor1DigitalOutAddress, 1);
+	setDigitalOutput(m_motor2DigitalOutAddress, 1);
+	setDigitalOutput(m_motor3DigitalOutAddress, 1);
+	setDigitalOutput(m_motor4DigitalOutAddress, 1);
+	setDigitalOutput(m_motor5DigitalOutAddress, 1);
+	setDigitalOutput(m_motor6DigitalOutAddress, 1);
+    setDigitalOutput(m_motor8DigitalOutAddress, 1);
 
 
 	//Turn yellow light on
-    writeDigitalOutput(m_yellowLightDigitalOutAddress, 0);
-    writeDigitalOutput(m_greenLightDigitalOutAddress, 1);
-	writeDigitalOutput(m_redLightDigitalOutAddress, 0);
+    setDigitalOutput(m_yellowLightDigitalOutAddress, 0);
+    setDigitalOutput(m_greenLightDigitalOutAddress, 1);
+	setDigitalOutput(m_redLightDigitalOutAddress, 0);
+
+	//Send all staged coils in one frame
+	commitDigitalOutputs();
 
 	//disable timer adjust while running
 	ui->pushButtonMinus1->setEnabled(false);
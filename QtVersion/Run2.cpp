@@ -41,22 +41,25 @@ void MainWindow::stateRun2()
 
 
 	//Set motor output on (all 8 motors)
-	writeDigitalOutput(m_motor1DigitalOutAddress, 1);
-	writeDigitalOutput(m_motor2DigitalOutAddress, 1);
-	writeDigitalOutput(m_motor3DigitalOutAddress, 1);
-	writeDigitalOutput(m_motor4DigitalOutAddress, 1);
-	writeDigitalOutput(m_motor5DigitalOutAddress, 1);  // Fixed: was missing
-	writeDigitalOutput(m_motor6DigitalOutAddress, 1);  // Fixed: was missing
-    writeDigitalOutput(m_motor8DigitalOutAddress, 1);
+	setDigitalOutput(m_motor1DigitalOutAddress, 1);
+	setDigitalOutput(m_motor2DigitalOutAddress, 1);
+	setDigitalOutput(m_motor3DigitalOutAddress, 1);
+	setDigitalOutput(m_motor4DigitalOutAddress, 1);
+	setDigitalOutput(m_motor5DigitalOutAddress, 1);  // Fixed: was missing
+	setDigitalOutput(m_motor6DigitalOutAddress, 1);  // Fixed: was missing
+    setDigitalOutput(m_motor8DigitalOutAddress, 1);
 
 
 	//Start	counter timer (interval calculated from tray factors and speed)
 	timerCounter.start(static_cast<int>(counterTimerInterval * 1000.0));
 
 	//Set green light on (production active)
-	writeDigitalOutput(m_greenLightDigitalOutAddress, 1);
-	writeDigitalOutput(m_yellowLightDigitalOutAddress, 0);
-	writeDigitalOutput(m_redLightDigitalOutAddress, 0);
+	setDigitalOutput(m_greenLightDigitalOutAddress, 1);
+	setDigitalOutput(m_yellowLightDigitalOutAddress, 0);
+	setDigitalOutput(m_redLightDigitalOutAddress, 0);
+
+	//Send all staged coils in one frame
+	commitDigitalOutputs();
 
 }
 
@@ -18,18 +18,21 @@ void MainWindow::stateStop()
 	}
 
 	//stop motors
-	writeDigitalOutput(m_motor1DigitalOutAddress, 0);
-	writeDigitalOutput(m_motor2DigitalOutAddress, 0);
-	writeDigitalOutput(m_motor3DigitalOutAddress, 0);
-	writeDigitalOutput(m_motor4DigitalOutAddress, 0);
-	writeDigitalOutput(m_motor5DigitalOutAddress, 0);
-	writeDigitalOutput(m_motor6DigitalOutAddress, 0);
-    writeDigitalOutput(m_motor8DigitalOutAddress, 0);
+	setDigitalOutput(m_motor1DigitalOutAddress, 0);
+	setDigitalOutput(m_motor2DigitalOutAddress, 0);
+	setDigitalOutput(m_motor3DigitalOutAddress, 0);
+	setDigitalOutput(m_motor4DigitalOutAddress, 0);
+	setDigitalOutput(m_motor5DigitalOutAddress, 0);
+	setDigitalOutput(m_motor6DigitalOutAddress, 0);
+    setDigitalOutput(m_motor8DigitalOutAddress, 0);
 
 	//Set light to red
-	writeDigitalOutput(m_redLightDigitalOutAddress, 1);
-	writeDigitalOutput(m_yellowLightDigitalOutAddress, 0);
-	writeDigitalOutput(m_greenLightDigitalOutAddress, 0);
+	setDigitalOutput(m_redLightDigitalOutAddress, 1);
+	setDigitalOutput(m_yellowLightDigitalOutAddress, 0);
+	setDigitalOutput(m_greenLightDigitalOutAddress, 0);
+
+	//Send all staged coils in one frame
+	commitDigitalOutputs();
 
 	//stop timer and reset
 	timerMotors.stop();
@@ -20,14 +20,17 @@ void MainWindow::stateTimeDelay()
 	//This might be dependent on previous state
 	//Time delay can happen from Run1 or Run2
 	//Does the same thing happen from both states?
-	writeDigitalOutput(m_motor1DigitalOutAddress, 0);
-	writeDigitalOutput(m_motor2DigitalOutAddress, 0);
-    writeDigitalOutput(m_motor8DigitalOutAddress, 0);
+	setDigitalOutput(m_motor1DigitalOutAddress, 0);
+	setDigitalOutput(m_motor2DigitalOutAddress, 0);
+    setDigitalOutput(m_motor8DigitalOutAddress, 0);
 
 	//Set light to Yellow
-	writeDigitalOutput(m_yellowLightDigitalOutAddress, 1);
-	writeDigitalOutput(m_greenLightDigitalOutAddress, 0);
-	writeDigitalOutput(m_redLightDigitalOutAddress, 0);
+	setDigitalOutput(m_yellowLightDigitalOutAddress, 1);
+	setDigitalOutput(m_greenLightDigitalOutAddress, 0);
+	setDigitalOutput(m_redLightDigitalOutAddress, 0);
+
+	//Send all staged coils in one frame
+	commitDigitalOutputs();
 
 	//Make sure counterTimer is not running
 	if (timerCounter.isActive())
@@ -50,6 +50,7 @@ MainWindow::MainWindow(QWidget *parent)
     } else {
         // Test mode: Create mock Modbus client (always connected)
         modbusClient1 = QSharedPointer<QModbusRtuSerialClient>::create();
+        m_outputBus = QSharedPointer<ModbusBus>::create(modbusClient1);
         qInfo() << "Test mode: Modbus client mocked (no hardware required)";
         // Skip input scan thread in test mode (we'll use UI buttons instead)
     }
@@ -67,7 +68,7 @@ MainWindow::MainWindow(QWidget *parent)
     connect(&timerCounter, &QTimer::timeout, this, &MainWindow::incrementCurrentCounter);
 
     //connect input scan signal to input changed slot
-    connect(&myInputScan, &ScanInputs::inputChanged, this, &MainWindow::inputChanged);
+    connect(&myInputScan, &ScanInputs::inputsChanged, this, &MainWindow::inputsChanged);
 
     //connect buzzer timer to buzzer function
     connect(&timerBuzzer, &QTimer::timeout, this, &MainWindow::buzzerTimerDecrement);
@@ -168,6 +169,7 @@ void MainWindow::CreateInputScanThread()
 
     myInputScan.moveToThread(&inputScanThread);
     myInputScan.setComPort(m_inputPortName);
+    myInputScan.setMinPollInterval(m_inputPollMinMs);
 
     connect(&inputScanThread, &QThread::started, &myInputScan, &ScanInputs::run);
 
@@ -188,6 +190,9 @@ int MainWindow::createQModbusRtuSerialClient() {
     modbusClient1->setConnectionParameter(QModbusDevice::SerialDataBitsParameter, QSerialPort::Data8);
     modbusClient1->setConnectionParameter(QModbusDevice::SerialStopBitsParameter, QSerialPort::OneStop);
 
+    // All output-port traffic is queued through the bus so E-stop writes go first
+    m_outputBus = QSharedPointer<ModbusBus>::create(modbusClient1);
+
     // Connect to the Modbus device
     if (!modbusClient1->connectDevice()) {
         qDebug() << "Failed to connect to Modbus Output Device";
@@ -457,6 +462,45 @@ void MainWindow::on_actionReset_Total_Counter_triggered()
     }
 }
 
+/**
+ * @brief Handle every input that changed in one read
+ *
+ * Inputs are dispatched in safety order - E-STOP, Stop, Start, Start
+ * Delay, then any other input - so a read that sees E-STOP together with
+ * another button always stops the line first.
+ */
+void MainWindow::inputsChanged(quint32 inputs, quint32 changed, qint64 sampledAt)
+{
+    qDebug() << "MainWindow Inputs:" << Qt::hex << inputs << "changed:" << changed;
+    const quint32 eStopBit = 1u << eStopButtonAddress;
+    const bool eStopPressed = (changed & eStopBit) && !(inputs & eStopBit);  //EStop is NC
+
+    const int priorityOrder[] = { eStopButtonAddress, stopButtonAddress, startButtonAddress, startDelayButtonAddress };
+    for (int address : priorityOrder) {
+        const quint32 bit = 1u << address;
+        if (changed & bit) {
+            inputChanged(address, inputs & bit);
+            changed &= ~bit;
+        }
+    }
+    while (changed) {
+        const int address = qCountTrailingZeroBits(changed);
+        changed &= changed - 1;
+        inputChanged(address, inputs & (1u << address));
+    }
+
+    // Input-to-action latency (upper bound: change may have happened right after the previous read)
+    QElapsedTimer now;
+    now.start();
+    const qint64 latency = now.msecsSinceReference() - sampledAt;
+    m_inputLatencyMaxMs = qMax(m_inputLatencyMaxMs, latency);
+    m_inputLatencySumMs += latency;
+    ++m_inputLatencyCount;
+    if (eStopPressed)
+        qCritical() << "E-STOP input handled within" << latency << "ms"
+                    << "(avg" << m_inputLatencySumMs / m_inputLatencyCount << "ms, max" << m_inputLatencyMaxMs << "ms)";
+}
+
 void MainWindow::inputChanged(int address, bool value)
 {
     qDebug() << "MainWindow Input: " << address << "status: " << value;
@@ -475,14 +519,15 @@ void MainWindow::inputChanged(int address, bool value)
 
 void MainWindow::sendMotorSpeedsToModbus()
 {
-    //send motor speeds to modbus
-    writeAnalogOutput(motor1->analogAddress(), motor1->speed());
-    writeAnalogOutput(motor2->analogAddress(), motor2->speed());
-    writeAnalogOutput(motor3->analogAddress(), motor3->speed());
-    writeAnalogOutput(motor4->analogAddress(), motor4->speed());
-    writeAnalogOutput(motor5->analogAddress(), motor5->speed());
-    writeAnalogOutput(motor6->analogAddress(), motor6->speed());
-    writeAnalogOutput(motor8->analogAddress(), motor8->speed());
+    //stage motor speeds, then send the changed channels in one frame
+    setAnalogOutput(motor1->analogAddress(), motor1->speed());
+    setAnalogOutput(motor2->analogAddress(), motor2->speed());
+    setAnalogOutput(motor3->analogAddress(), motor3->speed());
+    setAnalogOutput(motor4->analogAddress(), motor4->speed());
+    setAnalogOutput(motor5->analogAddress(), motor5->speed());
+    setAnalogOutput(motor6->analogAddress(), motor6->speed());
+    setAnalogOutput(motor8->analogAddress(), motor8->speed());
+    commitAnalogOutputs();
 }
 
 void MainWindow::handleSpeedChange(int speed, const QString& displayColor)
@@ -712,9 +757,10 @@ void MainWindow::eStopButtonChanged(quint16 onOff)
 void MainWindow::turn_all_outputs_off()
 {
     qInfo() << "Turning all outputs off";
-    for (int var = 0; var < 16; ++var) {
-        writeDigitalOutput(var, 0);
-    }
+    // Clear the whole image and force every coil to be rewritten in one frame
+    m_coilImage = 0;
+    m_coilsKnown = false;
+    commitDigitalOutputs();
 }
 
 void MainWindow::closeEvent(QCloseEvent *event) {
@@ -731,6 +777,9 @@ void MainWindow::closeEvent(QCloseEvent *event) {
     } else {
         //Enter Stop State before close - need to test
         stateStop();
+
+        if (m_outputBus)
+            m_outputBus->logStatistics();
         
         // Ensure counter is saved before exit
         if (m_countersSinceLastWrite > 0) {
@@ -14,6 +14,7 @@
 #include <QDir>
 
 #include <QTimer>
+#include <QElapsedTimer>
 
 #include <QThread>
 #include <QSharedPointer>
@@ -24,6 +25,7 @@
 #include "Counter.h"
 #include "tray.h"
 #include "ProductionLog.h"
+#include "ModbusBus.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -92,9 +94,15 @@ private:
 
 	// === Core Functions ===
 	void countDownTimerDecrement();  // TimeDelay state countdown handler
-    int writeDigitalOutput(quint16 address, int onOff);  // Modbus digital output (motor on/off)
+    int writeDigitalOutput(quint16 address, int onOff);  // Set one coil and commit immediately
+	void setDigitalOutput(quint16 address, int onOff);   // Stage a coil in the output image (no bus traffic)
+	int commitDigitalOutputs();  // Send all changed coils in one FC15 write-multiple-coils frame
+	void reportEstopMotorsOff(quint16 image);  // Log E-STOP-to-motors-off time when acknowledged
+	quint16 motorCoilMask() const;  // Coil bits of all motor relays
 	void handleDOReplyFinished();  // Async response handler for digital outputs
-	int writeAnalogOutput(int motorAddress, int percent);  // Modbus analog output (motor speed 0-100%)
+	int writeAnalogOutput(int motorAddress, int percent);  // Set one analog channel and commit immediately
+	void setAnalogOutput(int motorAddress, int percent);  // Stage a channel in the analog image (no bus traffic)
+	int commitAnalogOutputs();  // Send all changed channels in one FC16 write-multiple-registers frame
 	int calculateAnalogValue(int percent);  // Convert percent to Modbus value (0-32767)
 	void adjustWaitTime(int adjustment);  // Increment/decrement wait timer
 	void sendMotorSpeedsToModbus();  // Batch send all motor speeds
@@ -199,11 +207,13 @@ private:
 	// === Modbus RTU Communication ===
     QString m_outputPortName{ "COM4" };  // Default output port (digital + analog)
     QString m_inputPortName{ "COM5" };   // Default input port (digital inputs)
+	int m_inputPollMinMs{ 10 };          // Fastest input poll interval ("PollMinMs" on InputCom)
 	void readCOMPorts();   // Load COM port config from JSON
 	void writeCOMPorts();  // Save COM port config to JSON
 	void updateCOMPorts(QString NewInputPort, QString NewOutputPort);  // Update and persist ports
 	int createQModbusRtuSerialClient();  // Initialize Modbus client (57600 baud, 8N1)
 	QSharedPointer<QModbusRtuSerialClient> modbusClient1;  // Shared Modbus client for I/O
+	QSharedPointer<ModbusBus> m_outputBus;  // Prioritised scheduler for all modbusClient1 traffic
 	QModbusDataUnit writeAnalogOut;  // Analog output data unit (defined in writeanalogoutput.cpp)
 
 	// Modbus device addresses
@@ -270,6 +280,28 @@ private:
 	const quint16 m_EStopOutDigitalOutAddress{ 12 };
 	const quint16 m_EStopOutModbusDigitalDeviceID{ 1 };
 
+	// === Input-to-Action Latency ===
+	// Measured from the earliest moment an input change could have happened
+	// (see ScanInputs::inputChanged) to the end of its handler
+	qint64 m_inputLatencyMaxMs{ 0 };
+	qint64 m_inputLatencySumMs{ 0 };
+	int m_inputLatencyCount{ 0 };
+
+	// === Digital Output Image ===
+	// Coils are staged here and sent together by commitDigitalOutputs()
+	static constexpr int COIL_IMAGE_SIZE = 16;  // Coils 0-15 on the output module
+	quint16 m_coilImage{ 0 };      // Desired coil states, bit n = coil n
+	quint16 m_coilCommitted{ 0 };  // Coil states last sent to the module
+	bool m_coilsKnown{ false };    // False until the first write, or after a failed one
+	QElapsedTimer m_estopTimer;    // Started on E-STOP, reported when motors are off
+
+	// === Analog Output Image ===
+	// Channel millivolts are staged here and sent together by commitAnalogOutputs()
+	static constexpr int ANALOG_CHANNELS = 8;  // Waveshare Analog Output 8CH
+	quint16 m_analogImage[ANALOG_CHANNELS]{};      // Desired output per channel (mV)
+	quint16 m_analogCommitted[ANALOG_CHANNELS]{};  // Output last sent to the module (mV)
+	quint8 m_analogKnown{ 0 };  // Bit n set once channel n has been written successfully
+
 	QModbusReply* replyDigitalOut;
 	QModbusReply* replyAnalogOut;
 	//QModbusReply *replyAnalogInitial;
@@ -314,7 +346,8 @@ private slots:
 
 public slots:
 	void modbusConnected(bool connected);
-	void inputChanged(int address, bool value);
+	void inputsChanged(quint32 inputs, quint32 changed, qint64 sampledAt);  // Batched input changes from ScanInputs
+	void inputChanged(int address, bool value);  // Single input transition
 	void startButtonChanged(quint16 onOff);
 	void stopButtonChanged(quint16 onOff);
 	void startDelayButtonChanged(quint16 onOff);
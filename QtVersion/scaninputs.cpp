@@ -44,6 +44,11 @@ void ScanInputs::connectModbus(QString port)
 	modbusClient->setConnectionParameter(QModbusDevice::SerialStopBitsParameter,
 		QSerialPort::OneStop);
 
+	m_bus = QSharedPointer<ModbusBus>::create(modbusClient);
+
+	// Backoff must be able to outlast a timed-out read
+	m_maxPollInterval = qMax(m_maxPollInterval, 2 * modbusClient->timeout());
+
 	if (!modbusClient->connectDevice())
 	{
 		qWarning() << "Error Connecting to Modbus Device";
@@ -63,57 +68,80 @@ void ScanInputs::setComPort(QString port)
 	
 }
 
-void ScanInputs::onReplyFinished()
+void ScanInputs::setMinPollInterval(int ms)
 {
-	QModbusReply* reply = qobject_cast<QModbusReply*>(sender());
-	if (!reply)
-	{
-		return;
-	}
+	m_minPollInterval = qBound(1, ms, m_maxPollInterval);
+	m_pollInterval = m_minPollInterval;
+}
+
+void ScanInputs::onReplyFinished(QModbusReply* reply)
+{
+	m_pollOutstanding = false;
+	const qint64 rtt = m_pollSent.elapsed();
 
 	// Check if the reply is finished and has no error
-	if (reply->isFinished() && reply->error() == QModbusDevice::NoError) {
-		// Get the result data unit from the reply
-		QModbusDataUnit result = reply->result();
-
-		// Loop through the values and print the coil status
-		for (int i = 0; i < result.valueCount(); i++) {
-			bool coilStatus = result.value(i); // Get the value as a bool
-			//qDebug() << "Coil" << i << "status:" << coilStatus;
-
-			//TODO Need to test
-			if (coilStatus != inputCache[i])
-			{
-				emit inputChanged(i, coilStatus);
-				inputCache[i] = coilStatus;
-				qInfo() << "Input" << i << "changed to" << coilStatus;
-			}
+	const bool good = reply && reply->isFinished() && reply->error() == QModbusDevice::NoError;
+	if (good) {
+		const qint64 sentAt = m_pollSent.msecsSinceReference();
+		const qint64 window = m_lastGoodSentAt ? sentAt + rtt - m_lastGoodSentAt : 0;
+		const qint64 changedAfter = m_lastGoodSentAt ? m_lastGoodSentAt : sentAt;
+
+		// Pack the inputs into a bitmask (the result shares the reply's
+		// value storage, so nothing is allocated on the poll path)
+		const QModbusDataUnit result = reply->result();
+		const qsizetype count = qMin<qsizetype>(result.valueCount(), 32);
+		quint32 inputs = 0;
+		for (qsizetype i = 0; i < count; ++i) {
+			if (result.value(i))
+				inputs |= 1u << i;
+		}
+
+		// One signal per poll carrying every bit that changed
+		const quint32 changed = inputs ^ m_inputMask;
+		if (changed) {
+			m_inputMask = inputs;
+			emit inputsChanged(inputs, changed, changedAfter);
+			qInfo() << "Inputs changed:" << Qt::hex << changed << "now" << inputs;
 		}
+
+		m_lastGoodSentAt = sentAt;
+		m_pollInterval = m_minPollInterval;
+		m_rttSum += rtt;
+		m_rttMax = qMax(m_rttMax, rtt);
+		m_windowMax = qMax(m_windowMax, window);
 	}
 	else {
-		// Handle the error
-		qDebug() << "Read error:" << reply->errorString();
+		// Handle the error - back off so a sick bus is not flooded
+		qDebug() << "Read error:" << (reply ? reply->errorString() : QStringLiteral("not sent"));
+		++m_pollErrors;
+		m_pollInterval = qMin(m_pollInterval * 2, m_maxPollInterval);
 	}
+	// Reply is deleted by the bus
+
+	if (++m_polls % STATS_EVERY_POLLS == 0)
+		logStatistics();
 
-	// Delete the reply object
-	reply->deleteLater();
+	// Healthy: next read no sooner than the interval after this one was sent.
+	// Failed: wait the whole backed-off interval from now - a timed-out
+	// read has already spent the client timeout, which would cancel it.
+	if (good)
+		m_timer->start(int(qMax<qint64>(0, m_pollInterval - rtt)));
+	else
+		m_timer->start(m_pollInterval);
 }
 
 void ScanInputs::timeout()
 {
 	//qInfo() << "ScanInputs timer timeout";
-	// Send the read request and get a QModbusReply object
-	QModbusReply const* reply = modbusClient->sendReadRequest(request, m_address);
+	if (m_pollOutstanding)
+		return;
+	m_pollOutstanding = true;
+	m_pollSent.start();
 
-	// Check if the reply is valid
-	if (reply) {
-		// Connect a slot to the finished signal of the reply
-		connect(reply, &QModbusReply::finished, this, &ScanInputs::onReplyFinished);
-	}
-	else {
-		// Handle the error
-		qWarning() << "Send error:" << modbusClient->errorString();
-	}
+	// Queue the read on the input port's bus (Poll class)
+	m_bus->sendRead(request, m_address, ModbusBus::Poll, [this](QModbusReply* reply) {
+		onReplyFinished(reply);
+	});
 }
 
 void ScanInputs::run()
@@ -124,19 +152,32 @@ void ScanInputs::run()
 	request.setStartAddress(0);
 	request.setValueCount(m_inputCount);  // Read 10 coils starting from analogAddress 0
 
-	inputCache.resize(request.valueCount());
-	inputCache.fill(true);
+	// Start with every input high so NC inputs (Stop, E-STOP) stay quiet
+	// and any open input reports on the first read
+	m_inputMask = m_inputCount >= 32 ? ~0u : (1u << m_inputCount) - 1;
 
 	m_timer = new QTimer(this);
+	m_timer->setSingleShot(true);
 	connect(m_timer, &QTimer::timeout, this, &ScanInputs::timeout);
-	m_timer->setInterval(m_timerDelay);
 	if (connected)
 	{
-		m_timer->start();
+		m_timer->start(0);
 	}
 }
 
 void ScanInputs::stop()
 {
 	m_timer->stop();
+	logStatistics();
+	if (m_bus)
+		m_bus->logStatistics();
+}
+
+void ScanInputs::logStatistics() const
+{
+	const quint32 good = m_polls - m_pollErrors;
+	qInfo() << "Input polling:" << m_polls << "reads," << m_pollErrors << "errors,"
+	        << "round trip avg" << (good ? m_rttSum / good : 0) << "ms max" << m_rttMax << "ms,"
+	        << "worst input-to-detection" << m_windowMax << "ms,"
+	        << "current interval" << m_pollInterval << "ms";
 }
@@ -3,9 +3,11 @@
 
 #include <QObject>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QtSerialBus>
 #include <QModbusClient>
 #include <QModbusRtuSerialClient>
+#include "ModbusBus.h"
 
 class ScanInputs : public QObject
 {
@@ -18,27 +20,54 @@ public:
     void stop();
     void connectModbus(QString port);
     void setComPort(QString port);
+    void setMinPollInterval(int ms);  // Floor on start-to-start time between reads
+    void logStatistics() const;
 
 public slots:
     void run();
 
 private:
     QSharedPointer<QModbusRtuSerialClient> modbusClient;
-    QTimer *m_timer;
+    QSharedPointer<ModbusBus> m_bus;  // Scheduler for the input port; polls use ModbusBus::Poll
+    QTimer *m_timer;  // Single-shot; schedules the next read after a reply
     QModbusDataUnit request;
-    QList<bool> inputCache;
+    quint32 m_inputMask{ 0 };  // Last read inputs, bit n = discrete input n
 
     bool connected {false};
     int m_address {2};
     const int m_inputCount {8};
     QString m_portName{ "COM5" };
-    int m_timerDelay{ 100 };
 
-    void onReplyFinished();
+    // === Adaptive polling ===
+    // The next read goes out as soon as the previous reply is in, but no
+    // sooner than m_minPollInterval after the previous read was sent.
+    // Failed reads double the interval up to m_maxPollInterval, counted
+    // from the failed reply so a timeout's own wait does not use it up.
+    int m_minPollInterval{ 10 };    // ms, healthy bus
+    int m_maxPollInterval{ 2000 };  // ms, backoff ceiling; kept above the client timeout()
+    int m_pollInterval{ 10 };       // ms, current
+    bool m_pollOutstanding{ false };
+    QElapsedTimer m_pollSent;       // Send time of the read in flight
+    qint64 m_lastGoodSentAt{ 0 };   // msecsSinceReference of the last good read's send
+
+    // Latency statistics (ms)
+    static constexpr int STATS_EVERY_POLLS = 60000;  // ~10 minutes at 10 ms
+    quint32 m_polls{ 0 };
+    quint32 m_pollErrors{ 0 };
+    qint64 m_rttSum{ 0 };
+    qint64 m_rttMax{ 0 };
+    qint64 m_windowMax{ 0 };  // Longest gap an input change could go unseen
+
+    void onReplyFinished(QModbusReply* reply);
     void timeout();
 
 signals:
-    void inputChanged(int address, bool value);
+    // Emitted once per read that changed anything.
+    // inputs:    all inputs, bit n = discrete input n
+    // changed:   bits that differ from the previous read
+    // sampledAt: QElapsedTimer::msecsSinceReference() of the earliest moment
+    //            the change could have happened (send time of the previous good read)
+    void inputsChanged(quint32 inputs, quint32 changed, qint64 sampledAt);
     //void modbusConnected(bool connected);
 
 };
@@ -16,55 +16,102 @@
 //40203 2 Type Code R / W
 //40204 3 Type Code R / W
 
+/**
+ * @brief Write a single analog output and send it immediately
+ *
+ * Convenience wrapper; stages the channel and commits, so any other
+ * staged channels go out in the same frame.
+ *
+ * @param motorAddress Analog output channel (0-7)
+ * @param percent Speed 0-100%
+ * @return 0 on success, -1 on failure
+ */
 int MainWindow::writeAnalogOutput(int motorAddress, int percent)
 {
+    setAnalogOutput(motorAddress, percent);
+    return commitAnalogOutputs();
+}
+
+/**
+ * @brief Stage an analog output in the channel image without touching the bus
+ *
+ * @param motorAddress Analog output channel (0-7)
+ * @param percent Speed 0-100% (clamped)
+ */
+void MainWindow::setAnalogOutput(int motorAddress, int percent)
+{
+    if (motorAddress < 0 || motorAddress >= ANALOG_CHANNELS) {
+        qWarning() << "Analog output channel out of range:" << motorAddress;
+        return;
+    }
+    if(percent > 100) percent = 100;
+    if(percent < 0) percent = 0;  // Safety: clamp to valid range
+    m_analogImage[motorAddress] = quint16(calculateAnalogValue(percent));
+}
+
+/**
+ * @brief Send all changed analog channels in one FC16 frame
+ *
+ * Writes the span from the lowest to the highest channel whose millivolt
+ * value differs from what the module was last told, as a single
+ * write-multiple-registers request (Device ID 3 - Waveshare Analog
+ * Output 8CH). Nothing is sent if no channel changed.
+ *
+ * @return 0 on success (or nothing to send), -1 on failure
+ */
+int MainWindow::commitAnalogOutputs()
+{
+    int first = -1;
+    int last = -1;
+    for (int ch = 0; ch < ANALOG_CHANNELS; ++ch) {
+        const bool known = m_analogKnown & (1u << ch);
+        if (!known || m_analogImage[ch] != m_analogCommitted[ch]) {
+            if (first < 0) first = ch;
+            last = ch;
+        }
+    }
+    if (first < 0)
+        return 0;
+    const int count = last - first + 1;
+
     // TEST MODE: Simulate successful write
     if (m_testMode) {
-        int voltage_mV = (percent * 10000) / 100;
-        qDebug() << "[TEST MODE] Analog Write simulated - Motor:" << motorAddress 
-                 << "Speed:" << percent << "%" 
-                 << "Voltage:" << voltage_mV << "mV (" << (voltage_mV/1000.0) << "V)";
+        for (int ch = first; ch <= last; ++ch) {
+            qDebug() << "[TEST MODE] Analog Write simulated - Channel:" << ch
+                     << "Voltage:" << m_analogImage[ch] << "mV (" << (m_analogImage[ch]/1000.0) << "V)";
+            m_analogCommitted[ch] = m_analogImage[ch];
+            m_analogKnown |= quint8(1u << ch);
+        }
         return 0;  // Always succeed in test mode
     }
 
     // Verify Modbus connection is active
     if (!modbusClient1 || modbusClient1->state() != QModbusDevice::ConnectedState) {
-        qWarning() << "Modbus client not connected! Cannot write analog output to address:" << motorAddress;
+        qWarning() << "Modbus client not connected! Cannot write analog channels:" << first << "-" << last;
         return -1;
     }
 
-    int analogValue {0};
-    if(percent > 100) percent = 100;
-    if(percent < 0) percent = 0;  // Safety: clamp to valid range
-    analogValue = calculateAnalogValue(percent);
-
-    QModbusDataUnit writeAnalogOut(QModbusDataUnit::HoldingRegisters, motorAddress, 1);
-    writeAnalogOut.setValue(0, analogValue);
+    QModbusDataUnit writeAnalogOut(QModbusDataUnit::HoldingRegisters, first, count);
+    for (int ch = first; ch <= last; ++ch) {
+        writeAnalogOut.setValue(ch - first, m_analogImage[ch]);
+        // Assume the write lands; a failed reply below puts this right
+        m_analogCommitted[ch] = m_analogImage[ch];
+        m_analogKnown |= quint8(1u << ch);
+    }
 
-    //Send the write request to Modbus device (Device ID 3 - Waveshare Analog Output 8CH)
-    if ((replyAnalogOut = modbusClient1->sendWriteRequest(writeAnalogOut, m_analogOutAddress))) {
-        if (!replyAnalogOut->isFinished()) {
-            QObject::connect(replyAnalogOut, &QModbusReply::finished, this, [this, motorAddress, percent, analogValue]() {
-                if (replyAnalogOut->error() == QModbusDevice::NoError) {
-                    qDebug() << "Analog Write successful - Motor:" << motorAddress 
-                             << "Speed:" << percent << "%" 
-                             << "Value:" << analogValue << "mV (" << (analogValue/1000.0) << "V)";
-                }
-                else {
-                    qWarning() << "Analog Write error - Motor:" << motorAddress << "Error:" << replyAnalogOut->errorString();
-                }
-                replyAnalogOut->deleteLater();  // Fixed memory leak
-            });
+    //Queue the write on the output bus (Device ID 3 - Waveshare Analog Output 8CH)
+    m_outputBus->sendWrite(writeAnalogOut, m_analogOutAddress, ModbusBus::Normal,
+        [this, first, last](QModbusReply* reply) {
+        if (reply && reply->error() == QModbusDevice::NoError) {
+            qDebug() << "Analog Write successful - Channels:" << first << "-" << last;
         }
         else {
-            replyAnalogOut->deleteLater();  // Fixed memory leak
-            return 0;
+            qWarning() << "Analog Write error - Channels:" << first << "-" << last << "Error:" << (reply ? reply->errorString() : QStringLiteral("not sent"));
+            // Resend these channels on the next commit
+            for (int ch = first; ch <= last; ++ch)
+                m_analogKnown &= quint8(~(1u << ch));
         }
-    }
-    else {
-        qWarning() << "Analog Write request failed:" << modbusClient1->errorString();
-        return -1;
-    }
+    });
     return 0;
 }
 
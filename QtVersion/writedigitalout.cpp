@@ -2,41 +2,91 @@
 #include <QMessageBox>
 
 /**
- * @brief Write digital output to Modbus device (motor on/off control)
- * 
- * Sends a single coil write command to the Modbus RTU output module.
- * Includes error handling for connection failures and E-stop retry logic.
- * 
+ * @brief Write a single digital output and send it immediately
+ *
+ * Convenience wrapper for callers that change one coil at a time (buzzer,
+ * E-stop output). Updates the coil image and commits it, so any other bits
+ * already staged go out in the same frame.
+ *
  * @param address Modbus coil address (0-based)
  * @param onOff 0 = OFF, 1 = ON
  * @return 0 on success, -1 on failure
- * 
+ */
+int MainWindow::writeDigitalOutput(quint16 address, int onOff)
+{
+  setDigitalOutput(address, onOff);
+  return commitDigitalOutputs();
+}
+
+/**
+ * @brief Stage a digital output in the coil image without touching the bus
+ *
+ * State handlers set every coil they care about and then call
+ * commitDigitalOutputs() once.
+ *
+ * @param address Modbus coil address (0-15)
+ * @param onOff 0 = OFF, 1 = ON
+ */
+void MainWindow::setDigitalOutput(quint16 address, int onOff)
+{
+  if (address >= COIL_IMAGE_SIZE) {
+      qWarning() << "Digital output address out of range:" << address;
+      return;
+  }
+  if (onOff)
+      m_coilImage |= quint16(1u << address);
+  else
+      m_coilImage &= quint16(~(1u << address));
+}
+
+/**
+ * @brief Send all changed coils to the output module in one FC15 frame
+ *
+ * Compares the coil image with what the module was last told and writes
+ * the span from the lowest to the highest changed coil as a single
+ * write-multiple-coils request. Unchanged coils inside the span are
+ * rewritten with their current value, which is harmless.
+ *
+ * @return 0 on success (or nothing to send), -1 on failure
+ *
  * Safety Features:
  * - Connection validation before write
  * - Critical error dialog if E-stop fails
- * - Automatic retry for E-stop operations
- * - Memory leak fix: deleteLater() on all QModbusReply objects
- * 
- * Thread Safety: Can be called from any thread (Modbus handles queuing)
+ * - Frames that open a motor relay go out in the bus Safety class
+ * - On a failed reply the committed image is marked unknown so the next
+ *   commit rewrites every coil; during E-stop that commit happens at once
+ * - Logs E-STOP-to-all-motors-off time when the frame that opens the
+ *   motor relays is acknowledged
  */
-int MainWindow::writeDigitalOutput(quint16 address, int onOff)
+int MainWindow::commitDigitalOutputs()
 {
+  quint16 changed = m_coilImage ^ m_coilCommitted;
+  if (!m_coilsKnown)
+      changed = quint16(0xFFFF);
+  if (changed == 0)
+      return 0;
+
+  int first = 0;
+  while (!(changed & (1u << first)))
+      ++first;
+  int last = COIL_IMAGE_SIZE - 1;
+  while (!(changed & (1u << last)))
+      --last;
+  const int count = last - first + 1;
+  const quint16 image = m_coilImage;
+
   // TEST MODE: Simulate successful write
   if (m_testMode) {
-      qDebug() << "[TEST MODE] Digital Write simulated - Address:" << address << "Value:" << onOff;
-      return 0;  // Always succeed in test mode
+      qDebug() << "[TEST MODE] Digital Write simulated - Coils:" << first << "-" << last
+               << "Image:" << Qt::hex << image;
+      m_coilCommitted = image;
+      m_coilsKnown = true;
+      reportEstopMotorsOff(image);
+      return 0;
   }
 
-  // Write to a single Modbus coil
-  // Verify Modbus connection is active
-
-  //ADAM 4056 has a starting address of 0017 - but for some reason the analogAddress needs to be 16
-  //Write 12 bits
-  //QModbusDataUnit writeOut(QModbusDataUnit::Coils, 16, 12);
-
-  //Single should be in the format of: writeOut(QModbusDataUnit::Coils, 16 + analogAddress, 1);
   if (!modbusClient1 || modbusClient1->state() != QModbusDevice::ConnectedState) {
-      qCritical() << "Modbus client not connected! Cannot write to address:" << address;
+      qCritical() << "Modbus client not connected! Cannot write coils:" << first << "-" << last;
       if (currentState == states::EstopState) {
           QMessageBox::critical(this, "Critical Error", 
               "Modbus communication lost during E-Stop!\nMotors may not be stopped!\nManually verify equipment is safe.");
@@ -44,40 +94,60 @@ int MainWindow::writeDigitalOutput(quint16 address, int onOff)
       return -1;
   }
 
-  QModbusDataUnit writeOut(QModbusDataUnit::Coils, address, 1);
-  writeOut.setValue(0, onOff);
+  QModbusDataUnit writeOut(QModbusDataUnit::Coils, first, count);
+  for (int i = 0; i < count; ++i)
+      writeOut.setValue(i, (image >> (first + i)) & 1u);
+
+  // Opening a motor relay (or anything during E-stop) jumps the bus queue
+  const bool shutdown = currentState == states::EstopState
+      || (m_coilCommitted & ~image & motorCoilMask()) != 0;
+
+  // Assume the write lands; a failed reply below puts this right
+  m_coilCommitted = image;
+  m_coilsKnown = true;
 
-  //Send the write request to Modbus device
-  if ((replyDigitalOut = modbusClient1->sendWriteRequest(writeOut, m_digitalOutAddress))) {
-      if (!replyDigitalOut->isFinished()) {
-          // Async completion - connect to finished signal
-          QObject::connect(replyDigitalOut, &QModbusReply::finished, this, [this, address, onOff]() {
-              if (replyDigitalOut->error() == QModbusDevice::NoError) {
-                  qDebug() << "Digital Write successful - Address:" << address << "Value:" << onOff;
-              }
-              else {
-                  qWarning() << "Digital Write error - Address:" << address << "Error:" << replyDigitalOut->errorString();
-                  // For critical safety operations (E-stop), show error and retry
-                  if (currentState == states::EstopState) {
-                      qCritical() << "E-STOP: Retrying motor shutdown for address" << address;
-                      writeDigitalOutput(address, 0);  // Retry turning off motor
-                  }
-              }
-              replyDigitalOut->deleteLater();  // Fixed memory leak
-          });
+  //Queue the write on the output bus
+  m_outputBus->sendWrite(writeOut, m_digitalOutAddress,
+      shutdown ? ModbusBus::Safety : ModbusBus::Normal,
+      [this, first, last, image](QModbusReply* reply) {
+      if (reply && reply->error() == QModbusDevice::NoError) {
+          qDebug() << "Digital Write successful - Coils:" << first << "-" << last << "Image:" << Qt::hex << image;
+          reportEstopMotorsOff(image);
       }
       else {
-          replyDigitalOut->deleteLater();  // Fixed memory leak
-          return 0;
+          qWarning() << "Digital Write error - Coils:" << first << "-" << last << "Error:" << (reply ? reply->errorString() : QStringLiteral("not sent"));
+          m_coilsKnown = false;
+          // For critical safety operations (E-stop), resend the whole image
+          if (currentState == states::EstopState) {
+              qCritical() << "E-STOP: Retrying motor shutdown";
+              commitDigitalOutputs();
+          }
       }
-  }
-  else {
-      qCritical() << "Digital Write request failed:" << modbusClient1->errorString();
-      return -1;
-  }
+  });
   return 0;
 }
 
+/**
+ * @brief Log the E-STOP-to-all-motors-off time once the motor relays are open
+ *
+ * @param image Coil image carried by the acknowledged frame
+ */
+void MainWindow::reportEstopMotorsOff(quint16 image)
+{
+  if (!m_estopTimer.isValid() || (image & motorCoilMask()) != 0)
+      return;
+  qCritical() << "E-STOP: all motors off after" << m_estopTimer.elapsed() << "ms";
+  m_estopTimer.invalidate();
+}
+
+quint16 MainWindow::motorCoilMask() const
+{
+  return quint16((1u << m_motor1DigitalOutAddress) | (1u << m_motor2DigitalOutAddress) |
+                 (1u << m_motor3DigitalOutAddress) | (1u << m_motor4DigitalOutAddress) |
+                 (1u << m_motor5DigitalOutAddress) | (1u << m_motor6DigitalOutAddress) |
+                 (1u << m_motor8DigitalOutAddress));
+}
+
 void MainWindow::handleDOReplyFinished()
 {
   if (replyDigitalOut->error() == QModbusDevice::NoError)
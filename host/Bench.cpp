@@ -0,0 +1,238 @@
+/**
+ * @file Bench.cpp
+ * @brief Scan-cycle benchmark for the firmware on the simulated backplane
+ *
+ * Drives setup()/loop() from src/main.cpp through a scripted production
+ * scenario (HMI polling, start, time delay, e-stop, stop, calibration
+ * save) and reports min / mean / p99 / max cost of each scan stage
+ * against the SCAN_CYCLE_MS budget.
+ */
+
+#include "HostSim.h"
+#include "Config.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+void setup();
+void loop();
+
+namespace {
+
+// ── Stage timing (fed by SCAN_PROBE marks in loop()) ────────────────────
+struct StageStats {
+    const char*           name;
+    std::vector<uint64_t> ns;
+};
+
+std::vector<StageStats> g_stages;
+uint64_t                g_markNs = 0;
+
+void onProbe(const char* stage) {
+    uint64_t now = hostsim::nowNs();
+    uint64_t dt  = now - g_markNs;
+    g_markNs     = now;
+
+    for (StageStats& s : g_stages) {
+        if (std::strcmp(s.name, stage) == 0) { s.ns.push_back(dt); return; }
+    }
+    g_stages.push_back({ stage, { dt } });
+}
+
+struct Summary {
+    double minUs, meanUs, p99Us, maxUs;
+};
+
+Summary summarise(std::vector<uint64_t> v) {
+    Summary r = { 0, 0, 0, 0 };
+    if (v.empty()) return r;
+    std::sort(v.begin(), v.end());
+    double sum = 0;
+    for (uint64_t x : v) sum += static_cast<double>(x);
+    size_t p99 = (v.size() * 99 + 99) / 100 - 1;
+    r.minUs  = v.front() / 1000.0;
+    r.meanUs = sum / v.size() / 1000.0;
+    r.p99Us  = v[std::min(p99, v.size() - 1)] / 1000.0;
+    r.maxUs  = v.back() / 1000.0;
+    return r;
+}
+
+void printRow(const char* name, const Summary& s) {
+    std::printf("  %-24s %9.2f %9.2f %9.2f %9.2f %7.2f%%\n",
+                name, s.minUs, s.meanUs, s.p99Us, s.maxUs,
+                s.meanUs * 100.0 / (SCAN_CYCLE_MS * 1000.0));
+}
+
+// ── Scenario ────────────────────────────────────────────────────────────
+// One production period, in scans (20 ms each):
+//   START → buzzer → RUN1 → START_DELAY → 10 s delay → RUN2
+//   → E-STOP 1 s → clear → buzzer → RUN2 → STOP → save calibration
+constexpr unsigned long PERIOD = 2500;
+
+constexpr uint16_t IDLE_INPUTS = (1u << BIT_STOP) | (1u << BIT_ESTOP);  // NC closed
+
+// Deterministic arrival jitter for HMI requests within a scan period
+uint32_t g_lcg = 12345;
+uint32_t arrivalUs() {
+    g_lcg = g_lcg * 1103515245u + 12345u;
+    return (g_lcg >> 8) % (SCAN_CYCLE_MS * 1000u);
+}
+
+uint16_t scenarioInputs(unsigned long p) {
+    uint16_t in = IDLE_INPUTS;
+    if (p >= 10   && p < 13)   in |=  (1u << BIT_START);
+    if (p >= 700  && p < 703)  in |=  (1u << BIT_START_DELAY);
+    if (p >= 1700 && p < 1750) in &= ~(1u << BIT_ESTOP);
+    if (p >= 2300 && p < 2303) in &= ~(1u << BIT_STOP);
+    return in;
+}
+
+void scenarioHMI(int hmi, unsigned long scan) {
+    unsigned long p = scan % PERIOD;
+
+    if (scan == 0) {
+        hostsim::queueWriteHolding(hmi, Reg::SPEED_SELECT, 3);
+        hostsim::queueWriteHolding(hmi, Reg::TRAY_SELECT,  2);
+        hostsim::queueWriteHolding(hmi, Reg::TIMER_ADJUST,
+                                   static_cast<uint16_t>(10 - DEFAULT_WAIT_TIME));
+    }
+
+    // C-more keeps one read outstanding: the status block, and the
+    // calibration screen now and then.  Requests land anywhere in the
+    // scan period, not just at its start.
+    if (hostsim::pendingRequests(hmi) == 0) {
+        if (scan % 25 == 0)
+            hostsim::queueReadHolding(hmi, Reg::MOTOR_FACTORS_BASE, NUM_MOTORS * NUM_SPEEDS,
+                                      arrivalUs());
+        else
+            hostsim::queueReadHolding(hmi, Reg::STATE, 12, arrivalUs());
+    }
+
+    if (p == 2400) hostsim::queueWriteHolding(hmi, Reg::SAVE_CALIB, 1);
+}
+
+// A SCADA historian pipelines reads of the status and diagnostics
+// blocks as fast as it gets answers — the client that must not starve
+// the HMI.
+void scenarioHistorian(int historian) {
+    while (hostsim::pendingRequests(historian) < 3) {
+        hostsim::queueReadHolding(historian, Reg::STATE, Reg::STATUS_COUNT + 1, arrivalUs());
+        hostsim::queueReadHolding(historian, Reg::DIAG_MODBUS_US,
+                                  Reg::TOTAL_REGISTERS - Reg::DIAG_MODBUS_US, arrivalUs());
+    }
+}
+
+void usage() {
+    std::printf("usage: bonnie_host bench [--cycles N] [--backplane-us N] [--eth-us N]\n"
+                "                         [--modbus-us N] [--flash-erase-us N] [--flash-page-us N]\n"
+                "                         [--soft-float-ns N] [--historian] [--verbose]\n");
+}
+
+} // namespace
+
+int runBench(int argc, char** argv) {
+    unsigned long cycles  = 10000;
+    bool          verbose = false;
+    bool          withHistorian = false;
+
+    for (int i = 0; i < argc; i++) {
+        std::string a = argv[i];
+        bool hasVal = i + 1 < argc;
+        if      (a == "--cycles"         && hasVal) cycles = std::strtoul(argv[++i], nullptr, 10);
+        else if (a == "--backplane-us"   && hasVal) hostsim::cost.backplaneUs  = std::atoi(argv[++i]);
+        else if (a == "--eth-us"         && hasVal) hostsim::cost.ethPollUs    = std::atoi(argv[++i]);
+        else if (a == "--modbus-us"      && hasVal) hostsim::cost.modbusReqUs  = std::atoi(argv[++i]);
+        else if (a == "--flash-erase-us" && hasVal) hostsim::cost.flashEraseUs = std::atoi(argv[++i]);
+        else if (a == "--flash-page-us"  && hasVal) hostsim::cost.flashPageUs  = std::atoi(argv[++i]);
+        else if (a == "--soft-float-ns"  && hasVal) hostsim::cost.softFloatNs  = std::atoi(argv[++i]);
+        else if (a == "--historian")                withHistorian = true;
+        else if (a == "--verbose")                  verbose = true;
+        else { usage(); return 2; }
+    }
+
+    hostsim::setSerialEcho(verbose);
+    hostsim::setInputs(IDLE_INPUTS);
+    setup();
+
+    int hmi       = hostsim::connect();
+    int historian = withHistorian ? hostsim::connect() : -1;
+    hostsim::Counters before = hostsim::counters;
+
+    std::vector<uint64_t> work;        // sum of stages per scan
+    std::vector<uint64_t> period;      // start-to-start including padding
+    work.reserve(cycles);
+    period.reserve(cycles);
+
+    hostsim::setProbe(onProbe);
+    uint64_t prevStart = 0;
+    for (unsigned long scan = 0; scan < cycles; scan++) {
+        hostsim::setInputs(scenarioInputs(scan % PERIOD));
+        scenarioHMI(hmi, scan);
+        if (withHistorian) scenarioHistorian(historian);
+
+        uint64_t start = hostsim::nowNs();
+        g_markNs = start;
+        loop();
+        work.push_back(g_markNs - start);
+        if (scan) period.push_back(start - prevStart);
+        prevStart = start;
+    }
+    hostsim::setProbe(nullptr);
+    hostsim::Counters after = hostsim::counters;
+
+    // Read back what the firmware itself publishes in Reg::DIAG_*
+    while (hostsim::pendingRequests(hmi)) loop();
+    const uint16_t diagCount = Reg::DIAG_BP_SAVED_H - Reg::DIAG_MODBUS_US + 1;
+    hostsim::queueReadHolding(hmi, Reg::DIAG_MODBUS_US, diagCount);
+    loop();
+    std::vector<uint16_t> diag = hostsim::lastReply(hmi);
+    double n = static_cast<double>(cycles);
+
+    std::printf("Scan-cycle benchmark: %lu scans, budget %lu ms (SCAN_CYCLE_MS), %s scheduler\n",
+                cycles, SCAN_CYCLE_MS,
+                SCAN_SCHEDULER == SCAN_SCHED_DEADLINE ? "deadline" : "delay");
+    std::printf("Cost model: backplane %u us, eth poll %u us, modbus req %u us, "
+                "flash erase %u us, flash page %u us, soft-float op %u ns\n\n",
+                hostsim::cost.backplaneUs, hostsim::cost.ethPollUs,
+                hostsim::cost.modbusReqUs, hostsim::cost.flashEraseUs,
+                hostsim::cost.flashPageUs, hostsim::cost.softFloatNs);
+    std::printf("  %-24s %9s %9s %9s %9s %8s\n",
+                "stage", "min us", "mean us", "p99 us", "max us", "budget");
+    for (const StageStats& s : g_stages) printRow(s.name, summarise(s.ns));
+    std::printf("  %-24s\n", "------------------------");
+    printRow("scan work (sum)", summarise(work));
+    printRow("scan period", summarise(period));
+    printRow("HMI reply latency", summarise(hostsim::replyLatencies(hmi)));
+    if (withHistorian)
+        printRow("historian reply latency", summarise(hostsim::replyLatencies(historian)));
+
+    std::printf("\nPer scan: %.2f discrete reads, %.2f discrete writes, %.2f analog writes,\n"
+                "          %.2f eth polls, %.2f modbus requests, %.2f float ops\n",
+                (after.discreteReads  - before.discreteReads)  / n,
+                (after.discreteWrites - before.discreteWrites) / n,
+                (after.analogWrites   - before.analogWrites)   / n,
+                (after.ethPolls       - before.ethPolls)       / n,
+                (after.modbusRequests - before.modbusRequests) / n,
+                (after.softFloatOps   - before.softFloatOps)   / n);
+    std::printf("Flash: %llu row erases, %llu bytes programmed\n",
+                static_cast<unsigned long long>(after.flashRowErases - before.flashRowErases),
+                static_cast<unsigned long long>(after.flashBytesWritten - before.flashBytesWritten));
+    if (diag.size() == diagCount) {
+        auto at   = [&](int reg) { return diag[static_cast<size_t>(reg - Reg::DIAG_MODBUS_US)]; };
+        auto at32 = [&](int lo) {
+            return static_cast<unsigned long>(at(lo)) | (static_cast<unsigned long>(at(lo + 1)) << 16);
+        };
+        std::printf("Firmware diagnostics: last %u us, max %u us, avg %u us, overruns %lu\n"
+                    "                      backplane writes %lu issued, %lu skipped\n",
+                    at(Reg::DIAG_SCAN_LAST_US), at(Reg::DIAG_SCAN_MAX_US), at(Reg::DIAG_SCAN_AVG_US),
+                    at32(Reg::DIAG_OVERRUNS_L), at32(Reg::DIAG_BP_WRITES_L), at32(Reg::DIAG_BP_SAVED_L));
+    }
+    std::printf("HMI requests left unserved: %zu%s\n",
+                hostsim::pendingRequests(hmi),
+                hostsim::isConnected(hmi) ? "" : " (HMI disconnected)");
+    return 0;
+}
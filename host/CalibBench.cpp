@@ -0,0 +1,127 @@
+/**
+ * @file CalibBench.cpp
+ * @brief Cost of the HMI "Save Calibration" command
+ *
+ * Edits calibration registers the way the C-more calibration screen
+ * does and runs the two halves of the Save Calibration command as
+ * processHMICommands() does: the register sync
+ * (pullCalibrationFromRegisters) and the flash commit
+ * (saveCalibration).  Each is timed on its own, together with the
+ * register accesses and flash row erases it caused.  Register values
+ * alternate between two valid factors so every round really changes
+ * what it edits.
+ */
+
+#include "HostSim.h"
+#include "Config.h"
+
+#include <ArduinoModbus.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+void setup();
+void processHMICommands();
+void pullCalibrationFromRegisters();
+void saveCalibration();
+
+extern ModbusTCPServer modbusTCP;
+
+namespace {
+
+struct Case {
+    const char*      name;
+    std::vector<int> regs;     // calibration registers the operator edits
+};
+
+constexpr int BENCH_SPEED = 3;
+constexpr int BENCH_TRAY  = 2;
+
+uint16_t factorFor(int reg, unsigned round) {
+    // Tray time factors are seconds per count, the rest speed factors
+    uint16_t base = (reg >= Reg::TRAY_TIME_BASE && reg < Reg::TRAY_M8_BASE) ? 2000 : 1000;
+    return static_cast<uint16_t>(base + (round & 1) * 25);
+}
+
+std::vector<int> allCalibRegs() {
+    std::vector<int> v;
+    for (int i = 0; i < NUM_MOTORS * NUM_SPEEDS; i++) v.push_back(Reg::MOTOR_FACTORS_BASE + i);
+    for (int i = 0; i < NUM_TRAYS * NUM_SPEEDS; i++)  v.push_back(Reg::TRAY_TIME_BASE + i);
+    for (int i = 0; i < NUM_TRAYS * NUM_SPEEDS; i++)  v.push_back(Reg::TRAY_M8_BASE + i);
+    return v;
+}
+
+void usage() {
+    std::printf("usage: bonnie_host calib [--rounds N] [--register-us N] [--soft-float-ns N]\n"
+                "                         [--flash-erase-us N]\n");
+}
+
+} // namespace
+
+int runCalibBench(int argc, char** argv) {
+    unsigned rounds = 2000;
+
+    for (int i = 0; i < argc; i++) {
+        std::string a = argv[i];
+        bool hasVal = i + 1 < argc;
+        if      (a == "--rounds"         && hasVal) rounds = std::strtoul(argv[++i], nullptr, 10);
+        else if (a == "--register-us"    && hasVal) hostsim::cost.registerUs   = std::atoi(argv[++i]);
+        else if (a == "--soft-float-ns"  && hasVal) hostsim::cost.softFloatNs  = std::atoi(argv[++i]);
+        else if (a == "--flash-erase-us" && hasVal) hostsim::cost.flashEraseUs = std::atoi(argv[++i]);
+        else { usage(); return 2; }
+    }
+
+    hostsim::setSerialEcho(false);
+    hostsim::setInputs((1u << BIT_STOP) | (1u << BIT_ESTOP));
+    setup();
+
+    modbusTCP.holdingRegisterWrite(Reg::SPEED_SELECT, BENCH_SPEED);
+    modbusTCP.holdingRegisterWrite(Reg::TRAY_SELECT,  BENCH_TRAY);
+    processHMICommands();
+
+    const int si = BENCH_SPEED - 1;
+    const int ti = BENCH_TRAY  - 1;
+    const Case cases[] = {
+        { "no edits",                 {} },
+        { "1 factor, other speed",    { Reg::MOTOR_FACTORS_BASE + (si + 1) % NUM_SPEEDS } },
+        { "1 factor, active speed",   { Reg::MOTOR_FACTORS_BASE + si } },
+        { "active tray row (M8+time)",{ Reg::TRAY_TIME_BASE + ti * NUM_SPEEDS + si,
+                                        Reg::TRAY_M8_BASE   + ti * NUM_SPEEDS + si } },
+        { "whole screen (114)",       allCalibRegs() },
+    };
+
+    std::printf("Save Calibration cost: %u rounds per case\n"
+                "Cost model: register access %u us, soft-float op %u ns, flash erase %u us\n\n",
+                rounds, hostsim::cost.registerUs, hostsim::cost.softFloatNs,
+                hostsim::cost.flashEraseUs);
+    std::printf("  %-26s %9s %9s %9s %9s %9s %9s\n",
+                "case", "sync us", "reg reads", "reg wr", "fp ops", "save us", "erases");
+
+    for (const Case& c : cases) {
+        uint64_t syncNs = 0, saveNs = 0, reads = 0, writes = 0, fpOps = 0, erases = 0;
+        for (unsigned r = 0; r < rounds; r++) {
+            for (int reg : c.regs) modbusTCP.holdingRegisterWrite(reg, factorFor(reg, r));
+
+            hostsim::Counters pre = hostsim::counters;
+            uint64_t t0 = hostsim::nowNs();
+            pullCalibrationFromRegisters();
+            uint64_t t1 = hostsim::nowNs();
+            saveCalibration();
+            uint64_t t2 = hostsim::nowNs();
+
+            syncNs += t1 - t0;
+            saveNs += t2 - t1;
+            reads  += hostsim::counters.registerReads  - pre.registerReads;
+            writes += hostsim::counters.registerWrites - pre.registerWrites;
+            fpOps  += hostsim::counters.softFloatOps   - pre.softFloatOps;
+            erases += hostsim::counters.flashRowErases - pre.flashRowErases;
+        }
+        double n = static_cast<double>(rounds);
+        std::printf("  %-26s %9.2f %9.1f %9.1f %9.1f %9.2f %9.2f\n", c.name,
+                    syncNs / 1000.0 / n, reads / n, writes / n, fpOps / n,
+                    saveNs / 1000.0 / n, erases / n);
+    }
+    return 0;
+}
@@ -0,0 +1,29 @@
+/**
+ * @file HostMain.cpp
+ * @brief Entry point of the host-native firmware build
+ *
+ *   bonnie_host bench [options]   scan-cycle benchmark (see Bench.cpp)
+ *   bonnie_host calib [options]   Save Calibration cost (see CalibBench.cpp)
+ *   bonnie_host selftest <test>   pass/fail checks (see SelfTest.cpp)
+ */
+
+#include <cstdio>
+#include <cstring>
+
+int runBench(int argc, char** argv);
+int runCalibBench(int argc, char** argv);
+int runSelfTest(int argc, char** argv);
+
+int main(int argc, char** argv) {
+    const char* mode = argc > 1 ? argv[1] : "bench";
+
+    if (std::strcmp(mode, "bench") == 0)
+        return runBench(argc > 1 ? argc - 2 : 0, argv + 2);
+    if (std::strcmp(mode, "calib") == 0)
+        return runCalibBench(argc - 2, argv + 2);
+    if (std::strcmp(mode, "selftest") == 0)
+        return runSelfTest(argc - 2, argv + 2);
+
+    std::printf("usage: bonnie_host bench|calib|selftest [options]\n");
+    return 2;
+}
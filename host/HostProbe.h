@@ -0,0 +1,19 @@
+#ifndef HOST_PROBE_H
+#define HOST_PROBE_H
+
+/**
+ * @file HostProbe.h
+ * @brief Force-included into src/main.cpp by the host build
+ *
+ * Turns the SCAN_PROBE() marks in loop() into calls the benchmark can
+ * time, and SOFT_FLOAT_OPS() into a charge of CostModel::softFloatNs
+ * per operation.  On the P1AM both macros compile to nothing.
+ */
+
+void hostScanProbe(const char* stage);
+void hostSoftFloat(unsigned ops);
+
+#define SCAN_PROBE(stage)  hostScanProbe(stage)
+#define SOFT_FLOAT_OPS(n)  hostSoftFloat(n)
+
+#endif // HOST_PROBE_H
@@ -0,0 +1,441 @@
+/**
+ * @file HostSim.cpp
+ * @brief Simulated P1AM hardware behind the host stand-in libraries
+ *
+ * Implements the Arduino core, P1AM, Ethernet, ArduinoModbus and
+ * FlashStorage stand-ins declared in stubs/, plus the hostsim control
+ * API used by the benchmark harness.
+ */
+
+#include "HostSim.h"
+
+#include <Arduino.h>
+#include <P1AM.h>
+#include <Ethernet.h>
+#include <ArduinoModbus.h>
+#include <FlashStorage.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+
+// =====================================================================
+//  SIMULATED STATE
+// =====================================================================
+
+namespace {
+
+using SteadyClock = std::chrono::steady_clock;
+
+bool                   g_realtime   = true;
+uint64_t               g_virtualNs  = 0;
+int32_t                g_skewPpm    = 0;
+SteadyClock::time_point g_realStart = SteadyClock::now();
+
+bool                   g_serialEcho = true;
+hostsim::ProbeFn       g_probe      = nullptr;
+
+uint16_t               g_inputs     = 0;
+hostsim::InputFn       g_inputFn    = nullptr;
+uint16_t               g_relays     = 0;
+uint16_t               g_analog[9]  = {};   // 1-based channels
+
+struct Request {
+    uint8_t  fc;          // 3 = read holding, 6 = write single
+    uint16_t addr;
+    uint16_t arg;         // count (FC3) or value (FC6)
+    uint64_t arriveNs;    // not visible to the server before this
+};
+
+struct Socket {
+    bool                  open      = false;
+    bool                  accepted  = false;   // returned by accept()
+    std::deque<Request>   rx;
+    std::vector<uint16_t> reply;
+    std::vector<uint64_t> latencyNs;           // arrival → serviced
+};
+
+bool hasArrived(const Socket& s) {
+    return s.open && !s.rx.empty() && s.rx.front().arriveNs <= hostsim::nowNs();
+}
+
+Socket g_sock[MAX_SOCK_NUM];
+
+void charge(uint32_t us) { g_virtualNs += static_cast<uint64_t>(us) * 1000u; }
+
+// Time as the board's oscillator counts it
+uint64_t localNs() {
+    int64_t ns = static_cast<int64_t>(hostsim::nowNs());
+    return static_cast<uint64_t>(ns + ns / 1000000 * g_skewPpm);
+}
+
+} // namespace
+
+namespace hostsim {
+
+CostModel cost;
+Counters  counters;
+
+void setRealtime(bool on) {
+    // Fold real time spent so far into the virtual clock so it never jumps
+    g_virtualNs = nowNs();
+    g_realStart = SteadyClock::now();
+    g_realtime  = on;
+}
+
+uint64_t nowNs() {
+    uint64_t ns = g_virtualNs;
+    if (g_realtime) {
+        ns += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  SteadyClock::now() - g_realStart).count());
+    }
+    return ns;
+}
+
+void advanceUs(uint64_t us) { g_virtualNs += us * 1000u; }
+
+void setClockSkewPpm(int32_t ppm) { g_skewPpm = ppm; }
+
+void     setInputs(uint16_t mask)        { g_inputs = mask; }
+void     setInputFn(InputFn fn)          { g_inputFn = fn; }
+uint16_t inputs()                        { return g_inputs; }
+uint16_t relayOutputs()                  { return g_relays; }
+uint16_t analogOutput(uint8_t channel)   { return channel < 9 ? g_analog[channel] : 0; }
+
+int connect() {
+    for (int i = 0; i < MAX_SOCK_NUM; i++) {
+        if (!g_sock[i].open) {
+            g_sock[i] = Socket();
+            g_sock[i].open = true;
+            return i;
+        }
+    }
+    return -1;
+}
+
+void disconnect(int sock) {
+    if (sock >= 0 && sock < MAX_SOCK_NUM) g_sock[sock] = Socket();
+}
+
+bool isConnected(int sock) {
+    return sock >= 0 && sock < MAX_SOCK_NUM && g_sock[sock].open;
+}
+
+void queueReadHolding(int sock, uint16_t addr, uint16_t count, uint32_t inUs) {
+    if (isConnected(sock))
+        g_sock[sock].rx.push_back({ 3, addr, count, nowNs() + inUs * 1000ull });
+}
+
+void queueWriteHolding(int sock, uint16_t addr, uint16_t value, uint32_t inUs) {
+    if (isConnected(sock))
+        g_sock[sock].rx.push_back({ 6, addr, value, nowNs() + inUs * 1000ull });
+}
+
+size_t pendingRequests(int sock) {
+    return isConnected(sock) ? g_sock[sock].rx.size() : 0;
+}
+
+const std::vector<uint16_t>& lastReply(int sock) {
+    static const std::vector<uint16_t> none;
+    return isConnected(sock) ? g_sock[sock].reply : none;
+}
+
+const std::vector<uint64_t>& replyLatencies(int sock) {
+    static const std::vector<uint64_t> none;
+    return isConnected(sock) ? g_sock[sock].latencyNs : none;
+}
+
+void setSerialEcho(bool on) { g_serialEcho = on; }
+void setProbe(ProbeFn fn)   { g_probe = fn; }
+
+} // namespace hostsim
+
+void hostScanProbe(const char* stage) {
+    if (g_probe) g_probe(stage);
+}
+
+void hostSoftFloat(unsigned ops) {
+    hostsim::counters.softFloatOps += ops;
+    g_virtualNs += static_cast<uint64_t>(ops) * hostsim::cost.softFloatNs;
+}
+
+// =====================================================================
+//  ARDUINO CORE
+// =====================================================================
+
+HardwareSerial Serial;
+
+// The SAMD21 counters are 32-bit; keep the same wrap on the host
+uint32_t millis() { return static_cast<uint32_t>(localNs() / 1000000u); }
+uint32_t micros() { return static_cast<uint32_t>(localNs() / 1000u); }
+
+void delay(unsigned long ms)            { hostsim::advanceUs(static_cast<uint64_t>(ms) * 1000u); }
+void delayMicroseconds(unsigned int us) { hostsim::advanceUs(us); }
+
+size_t HardwareSerial::write(const char* s, size_t n) {
+    if (g_serialEcho) std::fwrite(s, 1, n, stdout);
+    return n;
+}
+
+size_t Print::print(long v, int base) {
+    char buf[24];
+    std::snprintf(buf, sizeof(buf), base == HEX ? "%lX" : "%ld", v);
+    return print(static_cast<const char*>(buf));
+}
+
+size_t Print::print(unsigned long v, int base) {
+    char buf[24];
+    std::snprintf(buf, sizeof(buf), base == HEX ? "%lX" : "%lu", v);
+    return print(static_cast<const char*>(buf));
+}
+
+size_t Print::print(double v, int digits) {
+    char buf[40];
+    std::snprintf(buf, sizeof(buf), "%.*f", digits, v);
+    return print(static_cast<const char*>(buf));
+}
+
+size_t Print::print(const Printable& p) { return p.printTo(*this); }
+
+size_t IPAddress::printTo(Print& p) const {
+    size_t n = 0;
+    for (int i = 0; i < 4; i++) {
+        if (i) n += p.print('.');
+        n += p.print(static_cast<unsigned int>(_a[i]));
+    }
+    return n;
+}
+
+// =====================================================================
+//  P1AM BACKPLANE
+// =====================================================================
+
+P1AM P1;
+
+uint8_t P1AM::init() { return 3; }   // three modules in the base
+
+uint32_t P1AM::readDiscrete(uint8_t, uint8_t) {
+    hostsim::counters.discreteReads++;
+    charge(hostsim::cost.backplaneUs);
+    return g_inputFn ? g_inputFn(hostsim::nowNs()) : g_inputs;
+}
+
+void P1AM::writeDiscrete(uint32_t data, uint8_t, uint8_t) {
+    hostsim::counters.discreteWrites++;
+    charge(hostsim::cost.backplaneUs);
+    g_relays = static_cast<uint16_t>(data);
+}
+
+int P1AM::readAnalog(uint8_t, uint8_t) {
+    charge(hostsim::cost.backplaneUs);
+    return 0;
+}
+
+void P1AM::writeAnalog(uint32_t data, uint8_t, uint8_t channel) {
+    hostsim::counters.analogWrites++;
+    charge(hostsim::cost.backplaneUs);
+    if (channel < 9) g_analog[channel] = static_cast<uint16_t>(data);
+}
+
+void P1AM::configWD(uint16_t, uint8_t) {}
+void P1AM::petWD() { hostsim::counters.watchdogPets++; }
+
+// =====================================================================
+//  ETHERNET (W5500)
+// =====================================================================
+
+EthernetClass Ethernet;
+
+void EthernetClass::init(uint8_t) {}
+
+int EthernetClass::begin(uint8_t*, IPAddress ip, IPAddress, IPAddress, IPAddress) {
+    _ip = ip;
+    return 1;
+}
+
+void EthernetServer::begin() {}
+
+EthernetClient EthernetServer::available() {
+    hostsim::counters.ethPolls++;
+    charge(hostsim::cost.ethPollUs);
+    for (int i = 0; i < MAX_SOCK_NUM; i++) {
+        if (hasArrived(g_sock[i])) {
+            g_sock[i].accepted = true;
+            return EthernetClient(static_cast<uint8_t>(i));
+        }
+    }
+    return EthernetClient();
+}
+
+EthernetClient EthernetServer::accept() {
+    hostsim::counters.ethPolls++;
+    charge(hostsim::cost.ethPollUs);
+    for (int i = 0; i < MAX_SOCK_NUM; i++) {
+        if (g_sock[i].open && !g_sock[i].accepted) {
+            g_sock[i].accepted = true;
+            return EthernetClient(static_cast<uint8_t>(i));
+        }
+    }
+    return EthernetClient();
+}
+
+uint8_t EthernetClient::connected() {
+    return _sock < MAX_SOCK_NUM && g_sock[_sock].open;
+}
+
+int EthernetClient::available() {
+    return _sock < MAX_SOCK_NUM && hasArrived(g_sock[_sock]) ? 1 : 0;
+}
+
+void EthernetClient::stop() {
+    if (_sock < MAX_SOCK_NUM) g_sock[_sock] = Socket();
+    _sock = MAX_SOCK_NUM;
+}
+
+// =====================================================================
+//  MODBUS TCP SERVER
+// =====================================================================
+
+int  ModbusTCPServer::begin(int) { return 1; }
+
+void ModbusTCPServer::accept(Client& client) { _client = &client; }
+
+int ModbusTCPServer::poll() {
+    hostsim::counters.ethPolls++;
+    charge(hostsim::cost.ethPollUs);
+
+    EthernetClient* ec = dynamic_cast<EthernetClient*>(_client);
+    if (!ec || !ec->connected()) return 0;
+
+    Socket& s = g_sock[ec->getSocketNumber()];
+    if (!hasArrived(s)) return 0;
+
+    Request req = s.rx.front();
+    s.rx.pop_front();
+    hostsim::counters.modbusRequests++;
+    charge(hostsim::cost.modbusReqUs);
+    s.latencyNs.push_back(hostsim::nowNs() - req.arriveNs);
+
+    s.reply.clear();
+    if (req.fc == 3) {
+        for (uint16_t i = 0; i < req.arg; i++) {
+            int r = req.addr + i - _hrStart;
+            s.reply.push_back(r >= 0 && r < static_cast<int>(_hr.size())
+                              ? _hr[static_cast<size_t>(r)] : 0);
+        }
+    } else if (req.fc == 6) {
+        int r = req.addr - _hrStart;
+        if (r >= 0 && r < static_cast<int>(_hr.size())) _hr[static_cast<size_t>(r)] = req.arg;
+        s.reply.push_back(req.arg);
+    }
+    return 1;
+}
+
+int ModbusTCPServer::configureHoldingRegisters(int startAddress, int nb) {
+    _hrStart = startAddress;
+    _hr.assign(static_cast<size_t>(nb), 0);
+    return 1;
+}
+
+int ModbusTCPServer::configureDiscreteInputs(int startAddress, int nb) {
+    _diStart = startAddress;
+    _di.assign(static_cast<size_t>(nb), 0);
+    return 1;
+}
+
+long ModbusTCPServer::holdingRegisterRead(int address) {
+    hostsim::counters.registerReads++;
+    charge(hostsim::cost.registerUs);
+    int i = address - _hrStart;
+    if (i < 0 || i >= static_cast<int>(_hr.size())) return -1;
+    return _hr[static_cast<size_t>(i)];
+}
+
+int ModbusTCPServer::holdingRegisterWrite(int address, uint16_t value) {
+    hostsim::counters.registerWrites++;
+    charge(hostsim::cost.registerUs);
+    int i = address - _hrStart;
+    if (i < 0 || i >= static_cast<int>(_hr.size())) return 0;
+    _hr[static_cast<size_t>(i)] = value;
+    return 1;
+}
+
+long ModbusTCPServer::discreteInputRead(int address) {
+    int i = address - _diStart;
+    if (i < 0 || i >= static_cast<int>(_di.size())) return -1;
+    return _di[static_cast<size_t>(i)];
+}
+
+int ModbusTCPServer::discreteInputWrite(int address, uint8_t value) {
+    int i = address - _diStart;
+    if (i < 0 || i >= static_cast<int>(_di.size())) return 0;
+    _di[static_cast<size_t>(i)] = value ? 1 : 0;
+    return 1;
+}
+
+// =====================================================================
+//  FLASH (SAMD21 NVM semantics)
+// =====================================================================
+
+namespace {
+
+// Writable mirror of one flash area, keyed by its address in the image
+struct FlashRegion {
+    uintptr_t            base;
+    std::vector<uint8_t> bytes;
+};
+
+std::vector<FlashRegion>& flashRegions() {
+    static std::vector<FlashRegion> regions;
+    return regions;
+}
+
+uint8_t* flashMirror(const volatile void* ptr, uint32_t size) {
+    uintptr_t p = reinterpret_cast<uintptr_t>(ptr);
+    for (FlashRegion& r : flashRegions()) {
+        if (p >= r.base && p + size <= r.base + r.bytes.size())
+            return r.bytes.data() + (p - r.base);
+    }
+    std::fprintf(stderr, "hostsim: flash access outside any declared area\n");
+    std::abort();
+}
+
+} // namespace
+
+FlashClass::FlashClass(const void* flash_addr, uint32_t size)
+    : flash_address(flash_addr), flash_size(size) {
+    if (!flash_addr) return;
+    // Whole rows, initial content copied from the image (zeroed)
+    uint32_t rows = (size + ROW_SIZE - 1) / ROW_SIZE;
+    const uint8_t* image = static_cast<const uint8_t*>(flash_addr);
+    flashRegions().push_back({ reinterpret_cast<uintptr_t>(flash_addr),
+                               std::vector<uint8_t>(image, image + rows * ROW_SIZE) });
+}
+
+void FlashClass::erase(const volatile void* flash_ptr, uint32_t size) {
+    // Erase every row touched by [flash_ptr, flash_ptr + size)
+    uintptr_t p     = reinterpret_cast<uintptr_t>(flash_ptr);
+    uintptr_t start = p & ~uintptr_t(ROW_SIZE - 1);
+    for (uintptr_t row = start; row < p + size; row += ROW_SIZE) {
+        std::memset(flashMirror(reinterpret_cast<const void*>(row), ROW_SIZE), 0xFF, ROW_SIZE);
+        hostsim::counters.flashRowErases++;
+        charge(hostsim::cost.flashEraseUs);
+    }
+}
+
+void FlashClass::write(const volatile void* flash_ptr, const void* data, uint32_t size) {
+    // Programming can only clear bits
+    uint8_t*       dst = flashMirror(flash_ptr, size);
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    for (uint32_t i = 0; i < size; i++) dst[i] &= src[i];
+    hostsim::counters.flashBytesWritten += size;
+
+    uintptr_t p     = reinterpret_cast<uintptr_t>(flash_ptr);
+    uintptr_t first = p / PAGE_SIZE, last = (p + size - 1) / PAGE_SIZE;
+    charge(hostsim::cost.flashPageUs * static_cast<uint32_t>(last - first + 1));
+}
+
+void FlashClass::read(const volatile void* flash_ptr, void* data, uint32_t size) {
+    std::memcpy(data, flashMirror(flash_ptr, size), size);
+}
@@ -0,0 +1,89 @@
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+/**
+ * @file HostSim.h
+ * @brief Control surface of the simulated P1AM hardware for host builds
+ *
+ * The stand-in libraries in stubs/ route every call here.  A harness
+ * (bench.cpp) uses this API to move the clock, drive the P1-16ND3
+ * inputs, act as a Modbus TCP client and read back what the firmware
+ * wrote to the backplane.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace hostsim {
+
+// ── Clock ───────────────────────────────────────────────────────────────
+// Simulated time = explicit advances (delay(), modelled costs) plus, in
+// realtime mode, the real host time spent running firmware code.
+void     setRealtime(bool on);
+uint64_t nowNs();
+void     advanceUs(uint64_t us);
+// The board's oscillator error: millis()/micros() run this many ppm
+// fast (negative: slow) against nowNs(), the true time.
+void     setClockSkewPpm(int32_t ppm);
+
+// ── Cost model ──────────────────────────────────────────────────────────
+// Per-operation costs charged to the simulated clock.  All default to 0
+// (pure host CPU time); plug in figures measured on the target.
+struct CostModel {
+    uint32_t backplaneUs  = 0;   // each P1.read*/write* SPI transaction
+    uint32_t ethPollUs    = 0;   // each W5500 status check (available/poll)
+    uint32_t modbusReqUs  = 0;   // each Modbus request serviced
+    uint32_t registerUs   = 0;   // each holding-register access by the firmware
+    uint32_t flashEraseUs = 0;   // each 256-byte NVM row erase
+    uint32_t flashPageUs  = 0;   // each 64-byte NVM page programmed
+    uint32_t softFloatNs  = 0;   // each float operation (SAMD21 has no FPU)
+};
+extern CostModel cost;
+
+// ── Transaction counters ────────────────────────────────────────────────
+struct Counters {
+    uint64_t discreteReads  = 0;
+    uint64_t discreteWrites = 0;
+    uint64_t analogWrites   = 0;
+    uint64_t ethPolls       = 0;
+    uint64_t modbusRequests = 0;
+    uint64_t registerReads  = 0;   // holding-register accesses by the firmware,
+    uint64_t registerWrites = 0;   // not by the server answering a client
+    uint64_t flashRowErases = 0;
+    uint64_t flashBytesWritten = 0;
+    uint64_t softFloatOps   = 0;
+    uint64_t watchdogPets   = 0;
+};
+extern Counters counters;
+
+// ── Backplane ───────────────────────────────────────────────────────────
+void     setInputs(uint16_t mask);        // P1-16ND3 field state
+// Time-varying field state (sensor pulses inside a scan); nullptr = setInputs
+typedef uint16_t (*InputFn)(uint64_t nowNs);
+void     setInputFn(InputFn fn);
+uint16_t inputs();
+uint16_t relayOutputs();                  // last P1-16TR write
+uint16_t analogOutput(uint8_t channel);   // last P1-08DAL-2 write (1-based)
+
+// ── Network (simulated Modbus TCP clients) ──────────────────────────────
+int  connect();                            // returns socket, -1 if none free
+void disconnect(int sock);
+bool isConnected(int sock);
+// Requests become visible to the server inUs after being queued
+void queueReadHolding(int sock, uint16_t addr, uint16_t count, uint32_t inUs = 0);
+void queueWriteHolding(int sock, uint16_t addr, uint16_t value, uint32_t inUs = 0);
+size_t pendingRequests(int sock);
+const std::vector<uint16_t>& lastReply(int sock);
+const std::vector<uint64_t>& replyLatencies(int sock);   // arrival → serviced
+
+// ── Serial ──────────────────────────────────────────────────────────────
+void setSerialEcho(bool on);
+
+// ── Scan probe (see HostProbe.h) ────────────────────────────────────────
+typedef void (*ProbeFn)(const char* stage);
+void setProbe(ProbeFn fn);
+
+} // namespace hostsim
+
+#endif // HOST_SIM_H
@@ -0,0 +1,1141 @@
+/**
+ * @file SelfTest.cpp
+ * @brief Pass/fail checks of firmware behaviour on the simulated backplane
+ *
+ *   counter   runs production for simulated hours with scan jitter and
+ *             compares the plant count against ideal elapsed time
+ *   photoeye  feeds bouncing photo-eye pulses shorter than two scans and
+ *             checks real counting, measured rate and auto-calibration
+ *   inputs    bounces the START button and drops single E-STOP reads, and
+ *             checks one start, no trip, and the glitch counters
+ *   trace     replays boot and an E-STOP recovery from the transition
+ *             trace registers alone
+ *   ramp      checks accel / decel ramp times of the analog outputs and
+ *             that E-STOP drops them in the same scan
+ *   startseq  checks the motor relays close one at a time in the
+ *             configured order and delays, with progress in a register
+ *   prodlog   drains production records through the readout window and
+ *             checks fields, exactly-once acks and overflow accounting
+ *   journal   reboots with records unsent, checks they come back from
+ *             flash, that numbering survives when only acks are left
+ *             and the lost count when the journal wraps, and that
+ *             commits never stretch a scan period
+ *   mailbox   pipelines commands through the mailbox and checks order,
+ *             result codes, out-of-order slots, one flash-writing
+ *             command per scan and sequence wrap
+ *   clock     runs 50 simulated days on a fast oscillator with a daily
+ *             sync, checks drift correction, real timestamps in the log
+ *             and trace, timers across the 49.7-day millis() wrap, and
+ *             that a months-long step of the PC clock is not taken as drift
+ *
+ * The clock is fully simulated (no host time leaks in), so every run
+ * is deterministic.  Exit status is 0 when every check passes.
+ */
+
+#include "HostSim.h"
+#include "Config.h"
+
+#include <Arduino.h>
+#include <ArduinoModbus.h>
+#include <FlashStorage.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+void setup();
+void loop();
+
+extern ModbusTCPServer modbusTCP;
+extern FlashClass prodJournal;
+
+namespace {
+
+constexpr uint16_t IDLE_INPUTS = (1u << BIT_STOP) | (1u << BIT_ESTOP);  // NC closed
+
+uint32_t g_lcg = 0xB0B1E5u;
+uint32_t nextRandom() {
+    g_lcg = g_lcg * 1103515245u + 12345u;
+    return g_lcg >> 8;
+}
+
+uint16_t reg(int address) {
+    return static_cast<uint16_t>(modbusTCP.holdingRegisterRead(address));
+}
+
+uint32_t currentCount() {
+    return reg(Reg::CURRENT_CTR_L) | (static_cast<uint32_t>(reg(Reg::CURRENT_CTR_H)) << 16);
+}
+
+/** One scan, sometimes late: ~5 % of scans stall up to maxStallUs
+ *  before loop() runs (flash erase, a burst of Modbus traffic). */
+void jitteredScan(uint32_t maxStallUs = 40000) {
+    if (nextRandom() % 20 == 0) hostsim::advanceUs(nextRandom() % maxStallUs);
+    loop();
+}
+
+struct CounterCase {
+    int      speed;         // 1-based
+    int      tray;          // 1-based
+    uint16_t trayTimeReg;   // seconds per count ×1000
+};
+
+/** Start production at the given tray time factor, run for `hours` of
+ *  simulated time and compare the count with elapsed / interval. */
+bool checkCounterCase(const CounterCase& c, double hours) {
+    int addr = Reg::TRAY_TIME_BASE + (c.tray - 1) * NUM_SPEEDS + (c.speed - 1);
+    modbusTCP.holdingRegisterWrite(addr, c.trayTimeReg);
+    modbusTCP.holdingRegisterWrite(Reg::SAVE_CALIB, 1);
+    modbusTCP.holdingRegisterWrite(Reg::SPEED_SELECT, c.speed);
+    modbusTCP.holdingRegisterWrite(Reg::TRAY_SELECT,  c.tray);
+    loop();
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::START);
+    while (reg(Reg::STATE) != STATE_RUN1) loop();
+
+    // Counting starts inside the scan that entered RUN1
+    uint64_t startNs = hostsim::nowNs();
+    uint32_t startCount = currentCount();
+    uint64_t runNs = static_cast<uint64_t>(hours * 3600.0 * 1e9);
+
+    while (hostsim::nowNs() - startNs < runNs) jitteredScan();
+
+    double elapsedS = (hostsim::nowNs() - startNs) / 1e9;
+    double ideal    = elapsedS * 1000.0 / c.trayTimeReg;
+    double counted  = currentCount() - startCount;
+    double error    = counted - ideal;
+
+    // A count can be pending for one scan plus the longest stall
+    double tolerance = 1.0 + (SCAN_CYCLE_MS + 40.0) / c.trayTimeReg;
+    bool   ok        = std::fabs(error) <= tolerance;
+
+    std::printf("  %.3f s/count, %.1f h: counted %.0f, ideal %.1f, error %+.1f (%+.0f ppm)  %s\n",
+                c.trayTimeReg / 1000.0, hours, counted, ideal, error,
+                ideal > 0 ? error * 1e6 / ideal : 0.0, ok ? "ok" : "FAIL");
+
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::STOP);
+    loop();
+    return ok;
+}
+
+int testCounter(double hours) {
+    std::printf("counter: drift against ideal elapsed time, 5 %% of scans late by up to 40 ms\n");
+    const CounterCase cases[] = {
+        { 3, 2,  350 },     // sub-second: the case that drifted
+        { 6, 1,  100 },     // fastest allowed (floor)
+        { 1, 5, 1234 },     // not a multiple of the scan period
+        { 4, 4, 2000 },     // factory default
+    };
+    bool ok = true;
+    for (const CounterCase& c : cases) ok &= checkCounterCase(c, hours);
+    return ok ? 0 : 1;
+}
+
+// ── Photo-eye: a plant every PLANT_PERIOD_US, beam blocked for
+//    PLANT_PULSE_US, with contact-style bounce on the leading edge and
+//    short noise spikes between plants. ───────────────────────────────
+constexpr uint64_t PLANT_PERIOD_US = 480000;
+constexpr uint64_t PLANT_PULSE_US  = 30000;
+constexpr uint64_t BOUNCE_US       = 1500;    // leading edge chatters this long
+uint64_t g_plantsFromNs = UINT64_MAX;         // first plant arrives here
+
+uint16_t photoEyeInputs(uint64_t nowNs) {
+    uint16_t in = IDLE_INPUTS;
+    if (nowNs < g_plantsFromNs) return in;
+    uint64_t us = (nowNs - g_plantsFromNs) / 1000;
+    uint64_t phase = us % PLANT_PERIOD_US;
+
+    bool beam;
+    if (phase < BOUNCE_US)           beam = (phase / 300) % 2 == 0;   // chatter
+    else if (phase < PLANT_PULSE_US) beam = true;
+    else                             beam = phase % 97003 < 500;     // noise spike
+    return beam ? static_cast<uint16_t>(in | (1u << BIT_PHOTO_EYE)) : in;
+}
+
+uint32_t sensorCount() {
+    return reg(Reg::SENSOR_COUNT_L) | (static_cast<uint32_t>(reg(Reg::SENSOR_COUNT_H)) << 16);
+}
+
+int testPhotoEye(double hours) {
+    std::printf("photoeye: %llu ms pulses every %llu ms, bouncing, 5 %% of scans late by up to 10 ms\n",
+                static_cast<unsigned long long>(PLANT_PULSE_US / 1000),
+                static_cast<unsigned long long>(PLANT_PERIOD_US / 1000));
+    bool ok = true;
+
+    modbusTCP.holdingRegisterWrite(Reg::COUNT_SOURCE, COUNT_SOURCE_SENSOR);
+    modbusTCP.holdingRegisterWrite(Reg::SPEED_SELECT, 2);
+    modbusTCP.holdingRegisterWrite(Reg::TRAY_SELECT,  3);
+    loop();
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::START);
+    while (reg(Reg::STATE) != STATE_RUN1) loop();
+    for (int i = 0; i < 60; i++) loop();        // publish the counting block
+
+    uint32_t startCount  = currentCount();
+    uint32_t startSensor = sensorCount();
+    hostsim::setInputFn(photoEyeInputs);
+    g_plantsFromNs = hostsim::nowNs() + 100000000;
+    uint64_t runNs = static_cast<uint64_t>(hours * 3600.0 * 1e9);
+
+    // A stall longer than a pulse would hide it: no CPU, no sample
+    while (hostsim::nowNs() < g_plantsFromNs + runNs) jitteredScan(10000);
+
+    // Stop feeding plants between two pulses, then let the block publish
+    auto passedUs = [] { return (hostsim::nowNs() - g_plantsFromNs) / 1000; };
+    while (passedUs() % PLANT_PERIOD_US < PLANT_PULSE_US + 50000) loop();
+    uint32_t plants = static_cast<uint32_t>(passedUs() / PLANT_PERIOD_US + 1);
+    hostsim::setInputFn(nullptr);
+    for (int i = 0; i < 100; i++) loop();
+    uint32_t counted  = currentCount() - startCount;
+    uint32_t pulses   = sensorCount() - startSensor;
+    bool countOk = counted == plants && pulses == plants;
+    std::printf("  plants %u, counted %u, photo-eye pulses %u  %s\n",
+                plants, counted, pulses, countOk ? "ok" : "FAIL");
+    ok &= countOk;
+
+    // Plants per minute ×10; the window opened ~1.3 s before the first plant
+    double ideal    = 600.0e6 / PLANT_PERIOD_US;
+    double measured = reg(Reg::RATE_MEASURED);
+    bool rateOk = std::fabs(measured - ideal) <= ideal * 0.01 + 1;
+    std::printf("  measured rate %.1f/min (ideal %.1f), estimated %.1f/min  %s\n",
+                measured / 10, ideal / 10, reg(Reg::RATE_ESTIMATED) / 10.0, rateOk ? "ok" : "FAIL");
+    ok &= rateOk;
+
+    modbusTCP.holdingRegisterWrite(Reg::AUTO_CALIB, 1);
+    loop();
+    for (int i = 0; i < 100; i++) loop();
+    uint16_t factor = reg(Reg::AUTOCAL_RESULT);
+    int      trayReg = Reg::TRAY_TIME_BASE + 2 * NUM_SPEEDS + 1;
+    bool calOk = std::abs(factor - static_cast<int>(PLANT_PERIOD_US / 1000)) <= 5 &&
+                 reg(trayReg) == factor;
+    std::printf("  auto-calibrated tray time %.3f s/plant, estimate now %.1f/min  %s\n",
+                factor / 1000.0, reg(Reg::RATE_ESTIMATED) / 10.0, calOk ? "ok" : "FAIL");
+    ok &= calOk;
+
+    hostsim::setInputFn(nullptr);
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::STOP);
+    loop();
+    return ok ? 0 : 1;
+}
+
+// ── Input filter: START integrates over 3 scans, E-STOP is 3-read
+//    majority (factory defaults). ─────────────────────────────────────
+uint16_t g_inputs = IDLE_INPUTS;
+
+uint16_t scriptedInputs(uint64_t) { return g_inputs; }
+
+/** Hold `in` for `scans` scans. */
+void holdInputs(uint16_t in, int scans) {
+    g_inputs = in;
+    for (int i = 0; i < scans; i++) loop();
+}
+
+bool check(const char* what, bool ok) {
+    std::printf("  %-52s %s\n", what, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+int testInputs() {
+    std::printf("inputs: integrator and majority filters on the 16-bit input mask\n");
+    bool ok = true;
+    const uint16_t start = IDLE_INPUTS | (1u << BIT_START);
+    const uint16_t noEstop = IDLE_INPUTS & ~(1u << BIT_ESTOP);
+    modbusTCP.holdingRegisterWrite(Reg::SPEED_SELECT, 1);
+    modbusTCP.holdingRegisterWrite(Reg::TRAY_SELECT,  1);
+    hostsim::setInputFn(scriptedInputs);
+    holdInputs(IDLE_INPUTS, 5);
+
+    // Contact bounce: closed one scan, open one, closed one, open
+    for (int i = 0; i < 4; i++) holdInputs(i % 2 ? IDLE_INPUTS : start, 1);
+    holdInputs(IDLE_INPUTS, 5);
+    ok &= check("bouncing START (1-scan closures) ignored", reg(Reg::STATE) == STATE_STOP);
+    holdInputs(start, 1);
+    ok &= check("raw mask shows the closure the filter holds back",
+                reg(Reg::DIAG_INPUT_RAW) == start && !(reg(Reg::INPUT_STATE) & (1u << BIT_START)));
+    holdInputs(IDLE_INPUTS, 5);
+    ok &= check("START glitches counted", reg(Reg::DIAG_GLITCH_BASE + BIT_START) >= 2);
+
+    // Single-scan E-STOP dropouts while idle
+    for (int i = 0; i < 10; i++) { holdInputs(noEstop, 1); holdInputs(IDLE_INPUTS, 4); }
+    ok &= check("single E-STOP dropouts do not trip", reg(Reg::STATE) == STATE_STOP);
+    ok &= check("E-STOP glitches counted (10)", reg(Reg::DIAG_GLITCH_BASE + BIT_ESTOP) == 10);
+
+    // A held press is accepted after the filter time, once
+    holdInputs(start, 3);
+    holdInputs(IDLE_INPUTS, 10);
+    ok &= check("START held 3 scans starts production", reg(Reg::STATE) != STATE_STOP);
+
+    // A real E-STOP (2 reads) trips
+    holdInputs(noEstop, 2);
+    ok &= check("E-STOP held 2 scans trips", reg(Reg::STATE) == STATE_ESTOP);
+    holdInputs(IDLE_INPUTS, 5);
+
+    // Filter time is editable: 0 ms = unfiltered, then single closures count
+    modbusTCP.holdingRegisterWrite(Reg::FILTER_MS_BASE + BIT_START, 0);
+    modbusTCP.holdingRegisterWrite(Reg::SAVE_CALIB, 1);
+    loop();
+    ok &= check("filter time 0 ms reads back as one scan",
+                reg(Reg::FILTER_MS_BASE + BIT_START) == SCAN_CYCLE_MS);
+    modbusTCP.holdingRegisterWrite(Reg::FILTER_MS_BASE + BIT_START, 1000);
+    modbusTCP.holdingRegisterWrite(Reg::SAVE_CALIB, 1);
+    loop();
+    ok &= check("filter time above the limit refused",
+                reg(Reg::FILTER_MS_BASE + BIT_START) == SCAN_CYCLE_MS);
+
+    modbusTCP.holdingRegisterWrite(Reg::DIAG_RESET, 1);
+    loop();
+    ok &= check("diagnostics reset clears glitch counters",
+                reg(Reg::DIAG_GLITCH_BASE + BIT_ESTOP) == 0);
+
+    hostsim::setInputFn(nullptr);
+    return ok ? 0 : 1;
+}
+
+// ── Transition trace ────────────────────────────────────────────────────
+struct Step { uint8_t source, event, from, to; };
+
+/** The `n` most recent trace entries, oldest first, read back from the
+ *  registers the way an HMI would. */
+std::vector<Step> readTrace(int n) {
+    std::vector<Step> v;
+    uint16_t count = reg(Reg::TRACE_COUNT);
+    for (int i = n; i > 0; i--) {
+        int slot = (count - i) % TRACE_DEPTH;
+        int base = Reg::TRACE_BASE + slot * Reg::TRACE_ENTRY_WORDS;
+        uint16_t ev = reg(base + 2), st = reg(base + 3);
+        v.push_back({ static_cast<uint8_t>(ev >> 8), static_cast<uint8_t>(ev & 0xFF),
+                      static_cast<uint8_t>(st >> 8), static_cast<uint8_t>(st & 0xFF) });
+    }
+    return v;
+}
+
+bool sameSteps(const std::vector<Step>& got, const std::vector<Step>& want) {
+    if (got.size() != want.size()) return false;
+    for (size_t i = 0; i < got.size(); i++) {
+        const Step& g = got[i];
+        const Step& w = want[i];
+        if (g.source != w.source || g.event != w.event || g.from != w.from || g.to != w.to)
+            return false;
+    }
+    return true;
+}
+
+int testTrace() {
+    std::printf("trace: transitions replayed from registers %d-%d\n",
+                Reg::TRACE_COUNT, Reg::TOTAL_REGISTERS - 1);
+    bool ok = true;
+    const uint16_t noEstop = IDLE_INPUTS & ~(1u << BIT_ESTOP);
+
+    ok &= check("boot recorded", reg(Reg::TRACE_COUNT) == 1 &&
+                sameSteps(readTrace(1), { { SRC_BOOT, EV_BOOT, STATE_STOP, STATE_STOP } }));
+
+    modbusTCP.holdingRegisterWrite(Reg::SPEED_SELECT, 2);
+    modbusTCP.holdingRegisterWrite(Reg::TRAY_SELECT,  2);
+    loop();
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::START);
+    hostsim::setInputFn(scriptedInputs);
+    holdInputs(IDLE_INPUTS, 200);              // 4 s: buzzer, then RUN1
+    holdInputs(noEstop, 50);                   // button E-STOP
+    holdInputs(IDLE_INPUTS, 200);              // released: warn, resume RUN1
+    hostsim::setInputFn(nullptr);
+
+    ok &= check("start, E-STOP and recovery replayed", sameSteps(readTrace(5), {
+        { SRC_HMI,    EV_START,       STATE_STOP,         STATE_BUZZER_DELAY },
+        { SRC_TIMER,  EV_BUZZER_DONE, STATE_BUZZER_DELAY, STATE_RUN1         },
+        { SRC_BUTTON, EV_ESTOP,       STATE_RUN1,         STATE_ESTOP        },
+        { SRC_BUTTON, EV_ESTOP_CLEAR, STATE_ESTOP,        STATE_BUZZER_DELAY },
+        { SRC_TIMER,  EV_BUZZER_DONE, STATE_BUZZER_DELAY, STATE_RUN1         },
+    }));
+
+    // Fill the ring past its depth; the count keeps going
+    for (int i = 0; i < TRACE_DEPTH; i++) {
+        modbusTCP.holdingRegisterWrite(Reg::COMMAND, i % 2 ? Cmd::START_DELAY : Cmd::ESTOP);
+        loop();
+        if (i % 2 == 0) { modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::ESTOP_CLEAR); loop(); }
+    }
+    ok &= check("ring wraps, newest entry is current state",
+                reg(Reg::TRACE_COUNT) > TRACE_DEPTH &&
+                readTrace(1)[0].to == reg(Reg::STATE));
+
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::STOP);
+    loop();
+    return ok ? 0 : 1;
+}
+
+// ── Motor ramps (factory defaults: 2 s up, 1 s down, full scale) ────────
+constexpr int RAMP_MOTOR = 3;           // motor 4, never partial-off
+
+uint16_t rampPos() { return reg(Reg::RAMP_POS_BASE + RAMP_MOTOR); }
+
+bool relayOn() {
+    return reg(Reg::OUTPUT_STATE) & (1u << MOTOR_DEFS[RAMP_MOTOR].relayBit);
+}
+
+/** Scans until the ramp position settles at `target`; -1 if it does not
+ *  within `limit` scans or ever moves by more than `maxStep`. */
+int scansToReach(uint16_t target, int maxStep, int limit) {
+    uint16_t last = rampPos();
+    for (int n = 1; n <= limit; n++) {
+        loop();
+        uint16_t pos = rampPos();
+        if (std::abs(pos - last) > maxStep) return -1;
+        if (pos == target) return n;
+        last = pos;
+    }
+    return -1;
+}
+
+int testRamp() {
+    std::printf("ramp: accel 2 s, decel 1 s, E-STOP bypass\n");
+    bool ok = true;
+    const int upStep   = (DAC_MAX * SCAN_CYCLE_MS + 1999) / 2000;
+    const int downStep = (DAC_MAX * SCAN_CYCLE_MS + 999) / 1000;
+
+    modbusTCP.holdingRegisterWrite(Reg::SPEED_SELECT, 6);
+    modbusTCP.holdingRegisterWrite(Reg::TRAY_SELECT,  1);
+    loop();
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::START);
+    while (reg(Reg::STATE) != STATE_RUN1) loop();
+    while (!relayOn()) loop();                  // its start sequence step
+    ok &= check("relay closes, DAC starts from 0", rampPos() <= upStep);
+
+    int up = scansToReach(static_cast<uint16_t>(percentToDAC(100.0f)), upStep, 200);
+    std::printf("    accel: %d scans to full speed\n", up);
+    ok &= check("accel reaches full speed in ~2 s, one step per scan", up >= 95 && up <= 101);
+
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::STOP);
+    loop();
+    ok &= check("STOP keeps the relay closed while decelerating", relayOn() && rampPos() > 0);
+    int down = scansToReach(0, downStep, 200);
+    std::printf("    decel: %d scans to 0\n", down);
+    ok &= check("decel reaches 0 in ~1 s", down >= 45 && down <= 51);
+    loop();
+    ok &= check("relay opens at 0", !relayOn());
+
+    // E-STOP at full speed
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::START);
+    while (reg(Reg::STATE) != STATE_RUN1) loop();
+    for (int i = 0; i < 250; i++) loop();
+    uint32_t writesBefore = hostsim::counters.analogWrites;
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::ESTOP);
+    loop();
+    ok &= check("E-STOP: DAC 0 and relay open in the same scan",
+                rampPos() == 0 && !relayOn() &&
+                hostsim::counters.analogWrites > writesBefore);
+
+    // Ramp time is editable; 0 = step
+    modbusTCP.holdingRegisterWrite(Reg::RAMP_ACCEL_BASE + RAMP_MOTOR, 0);
+    modbusTCP.holdingRegisterWrite(Reg::RAMP_DECEL_BASE + RAMP_MOTOR, 40000);
+    modbusTCP.holdingRegisterWrite(Reg::SAVE_CALIB, 1);
+    loop();
+    ok &= check("decel time above RAMP_MAX_MS refused",
+                reg(Reg::RAMP_DECEL_BASE + RAMP_MOTOR) == 1000);
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::ESTOP_CLEAR);
+    loop();
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::STOP);
+    loop();
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::START);
+    while (reg(Reg::STATE) != STATE_RUN1) loop();
+    while (!relayOn()) loop();
+    ok &= check("accel 0 ms steps straight to speed",
+                rampPos() == static_cast<uint16_t>(percentToDAC(100.0f)));
+
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::STOP);
+    loop();
+    return ok ? 0 : 1;
+}
+
+// ── Start sequence ──────────────────────────────────────────────────────
+struct RelayEvent { int motor; uint64_t atMs; };
+
+/** Runs scans and notes when each motor relay closes, in ms from the
+ *  RUN1 / RUN2 entry. */
+struct RelayWatch {
+    uint16_t                was    = reg(Reg::OUTPUT_STATE);
+    uint64_t                fromNs = 0;
+    std::vector<RelayEvent> closed;
+
+    void scan() {
+        uint64_t startNs = hostsim::nowNs();
+        loop();
+        uint16_t st = reg(Reg::STATE);
+        if (!fromNs && (st == STATE_RUN1 || st == STATE_RUN2)) fromNs = startNs;
+
+        uint16_t now = reg(Reg::OUTPUT_STATE);
+        for (int i = 0; i < NUM_MOTORS; i++) {
+            uint16_t bit = 1u << MOTOR_DEFS[i].relayBit;
+            if ((now & bit) && !(was & bit))
+                closed.push_back({ i == MOTOR_8_IDX ? 8 : i + 1, (startNs - fromNs) / 1000000 });
+        }
+        was = now;
+    }
+    void scans(int n) { for (int i = 0; i < n; i++) scan(); }
+
+    std::string describe() const {
+        std::string s;
+        for (const RelayEvent& e : closed)
+            s += " M" + std::to_string(e.motor) + "@" + std::to_string(e.atMs);
+        return s;
+    }
+
+    /** Closed in exactly this order, stepMs apart (within one scan). */
+    bool inOrder(const std::vector<int>& motors, uint64_t stepMs) const {
+        if (closed.size() != motors.size()) return false;
+        for (size_t k = 0; k < closed.size(); k++) {
+            if (closed[k].motor != motors[k]) return false;
+            uint64_t gap = k ? closed[k].atMs - closed[k - 1].atMs : stepMs;
+            if (gap < stepMs || gap > stepMs + SCAN_CYCLE_MS) return false;
+        }
+        return true;
+    }
+};
+
+/** Command START from STOP and watch the run's first `scans` scans. */
+RelayWatch watchStart(int scans) {
+    RelayWatch w;
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::START);
+    while (reg(Reg::STATE) != STATE_RUN1) w.scan();
+    w.scans(scans);
+    return w;
+}
+
+int testStartSequence() {
+    std::printf("startseq: staggered relay closing, downstream first\n");
+    bool ok = true;
+
+    modbusTCP.holdingRegisterWrite(Reg::SPEED_SELECT, 3);
+    modbusTCP.holdingRegisterWrite(Reg::TRAY_SELECT,  3);
+    loop();
+
+    RelayWatch w = watchStart(200);
+    std::printf("    default:%s\n", w.describe().c_str());
+    ok &= check("default order 6 5 4 3 8 2 1, 500 ms apart",
+                w.inOrder({ 6, 5, 4, 3, 8, 2, 1 }, 500));
+    ok &= check("progress register reads 7 when done", reg(Reg::START_SEQ_STEP) == NUM_MOTORS);
+
+    // TIME_DELAY → RUN2 restarts only motors 1, 2, 8, still in order
+    modbusTCP.holdingRegisterWrite(Reg::TIMER_ADJUST, static_cast<uint16_t>(-(DEFAULT_WAIT_TIME - 1)));
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::START_DELAY);
+    while (reg(Reg::STATE) != STATE_TIME_DELAY) loop();
+    w = RelayWatch();
+    while (reg(Reg::STATE) != STATE_RUN2) w.scan();
+    w.scans(100);
+    std::printf("    RUN2:   %s\n", w.describe().c_str());
+    ok &= check("RUN2 restarts 8 2 1, no gaps for running motors", w.inOrder({ 8, 2, 1 }, 500));
+
+    // Own order, shorter steps
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::STOP);
+    loop();
+    const uint16_t order[NUM_MOTORS] = { 8, 6, 5, 4, 3, 2, 1 };
+    for (int k = 0; k < NUM_MOTORS; k++)
+        modbusTCP.holdingRegisterWrite(Reg::START_ORDER_BASE + k, order[k]);
+    for (int k = 0; k < NUM_MOTORS - 1; k++)
+        modbusTCP.holdingRegisterWrite(Reg::START_DELAY_BASE + k, 200);
+    modbusTCP.holdingRegisterWrite(Reg::SAVE_CALIB, 1);
+    for (int i = 0; i < 100; i++) loop();           // decel ramps finish
+    w = watchStart(100);
+    std::printf("    200 ms: %s\n", w.describe().c_str());
+    ok &= check("edited order and 200 ms steps applied", w.inOrder({ 8, 6, 5, 4, 3, 2, 1 }, 200));
+
+    // E-STOP mid-sequence stops it for good
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::STOP);
+    for (int i = 0; i < 100; i++) loop();
+    w = watchStart(15);
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::ESTOP);
+    loop();
+    w = RelayWatch();
+    w.scans(100);
+    ok &= check("E-STOP mid-sequence: no further relay closes",
+                w.closed.empty() && (reg(Reg::OUTPUT_STATE) & MOTOR_ALL_MASK) == 0);
+
+    // An order naming a motor twice is refused as a whole
+    modbusTCP.holdingRegisterWrite(Reg::START_ORDER_BASE + 1, 8);
+    modbusTCP.holdingRegisterWrite(Reg::SAVE_CALIB, 1);
+    loop();
+    ok &= check("duplicate motor in order refused", reg(Reg::START_ORDER_BASE + 1) == 6);
+
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::ESTOP_CLEAR);
+    loop();
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::STOP);
+    loop();
+    return ok ? 0 : 1;
+}
+
+// ── Production log readout ──────────────────────────────────────────────
+struct LogRecord {
+    uint16_t seq, tray, speed, reason, durationS;
+    uint32_t time, batch, total;
+};
+
+/** Read the whole readout block in one request, as a poller would. */
+std::vector<LogRecord> readLogWindow() {
+    std::vector<LogRecord> v;
+    for (int w = 0; w < LOG_WINDOW_RECORDS; w++) {
+        int b = Reg::LOG_WINDOW_BASE + w * Reg::LOG_RECORD_WORDS;
+        if (reg(b) == 0) break;
+        auto u32 = [&](int off) { return reg(b + off) | (static_cast<uint32_t>(reg(b + off + 1)) << 16); };
+        v.push_back({ reg(b), static_cast<uint16_t>(reg(b + 3) >> 8),
+                      static_cast<uint16_t>(reg(b + 3) & 0xFF), reg(b + 4), reg(b + 9),
+                      u32(1), u32(5), u32(7) });
+    }
+    return v;
+}
+
+void ackLog(uint16_t seq) {
+    modbusTCP.holdingRegisterWrite(Reg::LOG_ACK, seq);
+    loop();
+}
+
+/** One short run: start, run `seconds`, then the given command. */
+void shortRun(int seconds, int endCmd) {
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::START);
+    while (reg(Reg::STATE) != STATE_RUN1) loop();
+    for (int i = 0; i < seconds * 50; i++) loop();
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, endCmd);
+    loop();
+    if (endCmd == Cmd::ESTOP) {
+        modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::ESTOP_CLEAR);
+        loop();
+    }
+}
+
+int testProductionLog() {
+    std::printf("prodlog: RAM ring drained through registers %d-%d\n",
+                Reg::LOG_PENDING, Reg::LOG_WINDOW_BASE + LOG_WINDOW_RECORDS * Reg::LOG_RECORD_WORDS - 1);
+    bool ok = true;
+
+    int trayReg = Reg::TRAY_TIME_BASE + (4 - 1) * NUM_SPEEDS + (5 - 1);
+    modbusTCP.holdingRegisterWrite(trayReg, 500);       // 2 plants / s
+    modbusTCP.holdingRegisterWrite(Reg::SAVE_CALIB, 1);
+    modbusTCP.holdingRegisterWrite(Reg::SPEED_SELECT, 5);
+    modbusTCP.holdingRegisterWrite(Reg::TRAY_SELECT,  4);
+    loop();
+    ok &= check("empty log: nothing pending, cursor 0",
+                reg(Reg::LOG_PENDING) == 0 && reg(Reg::LOG_CURSOR) == 0);
+
+    shortRun(10, Cmd::STOP);
+    shortRun(5,  Cmd::ESTOP);
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::RESET_CURRENT);
+    loop();
+
+    std::vector<LogRecord> v = readLogWindow();
+    for (const LogRecord& r : v)
+        std::printf("    #%u  t=%u s  tray %u speed %u  reason %u  batch %u  total %u  %u s\n",
+                    r.seq, r.time, r.tray, r.speed, r.reason, r.batch, r.total, r.durationS);
+    ok &= check("STOP, E-STOP and HMI reset each closed a record",
+                v.size() == 3 && reg(Reg::LOG_PENDING) == 3 &&
+                v[0].reason == STOP_REASON_STOP && v[1].reason == STOP_REASON_ESTOP &&
+                v[2].reason == STOP_REASON_HMI_RESET);
+    ok &= check("fields: tray, speed, counts, duration",
+                v.size() == 3 && v[0].tray == 4 && v[0].speed == 5 &&
+                v[0].batch == 20 && v[1].batch == 30 && v[2].batch == 30 &&
+                v[0].durationS == 10 && v[1].durationS == 5 && v[2].durationS == 0 &&
+                v[2].total == v[1].total && v[1].time > v[0].time);
+
+    // Ack the first two; a repeated ack must not drop the third
+    uint16_t first = v.empty() ? 0 : v[0].seq;
+    ackLog(static_cast<uint16_t>(first + 1));
+    ackLog(static_cast<uint16_t>(first + 1));
+    v = readLogWindow();
+    ok &= check("ack drops through the named record, repeat ignored",
+                v.size() == 1 && v[0].seq == first + 2 &&
+                reg(Reg::LOG_CURSOR) == first + 2 && reg(Reg::LOG_ACK) == 0);
+    ackLog(static_cast<uint16_t>(first + 2));
+    ok &= check("drained", reg(Reg::LOG_PENDING) == 0 && readLogWindow().empty());
+
+    // Overfill: the oldest records go, and are counted
+    for (int i = 0; i < LOG_DEPTH + 5; i++) shortRun(1, Cmd::STOP);
+    v = readLogWindow();
+    ok &= check("full ring keeps the newest LOG_DEPTH, counts 5 lost",
+                reg(Reg::LOG_PENDING) == LOG_DEPTH && reg(Reg::LOG_LOST) == 5 &&
+                v.size() == LOG_WINDOW_RECORDS && v[0].seq == first + 3 + 5);
+
+    // Page through everything in window-sized steps
+    unsigned drained = 0;
+    uint16_t expect  = v.empty() ? 0 : v[0].seq;
+    bool inOrder = true;
+    while (!(v = readLogWindow()).empty()) {
+        for (const LogRecord& r : v) inOrder &= r.seq == expect++;
+        drained += static_cast<unsigned>(v.size());
+        ackLog(v.back().seq);
+    }
+    ok &= check("paged out every record once, in order", drained == LOG_DEPTH && inOrder);
+    return ok ? 0 : 1;
+}
+
+// ── Production journal ──────────────────────────────────────────────────
+// Every scan start is checked against the SCAN_CYCLE_MS grid; flash
+// costs are the SAMD21 worst case.
+uint64_t g_lastScanNs  = 0;
+uint64_t g_maxPeriodNs = 0;
+
+void gridScan() {
+    uint64_t now = hostsim::nowNs();
+    if (g_lastScanNs && now - g_lastScanNs > g_maxPeriodNs) g_maxPeriodNs = now - g_lastScanNs;
+    g_lastScanNs = now;
+    loop();
+}
+
+/** Power cycle: RAM state is rebuilt by setup(), flash survives. */
+void reboot() {
+    setup();
+    g_lastScanNs = 0;
+    loop();
+}
+
+/** Blank every record entry in the production journal, leaving only
+ *  ack markers — what remains once the rows holding the records have
+ *  been recycled but a newer row with their acks has not. */
+void dropJournalRecords() {
+    static ProdJournalEntry image[PROD_JOURNAL_ENTRIES];
+    prodJournal.read(image);
+    for (ProdJournalEntry& e : image)
+        if (e.kind == JRN_RECORD) std::memset(&e, 0xFF, sizeof(e));
+    prodJournal.erase();
+    prodJournal.write(image);
+}
+
+int testJournal() {
+    std::printf("journal: unsent records survive a reboot; commits stay in scan slack\n");
+    bool ok = true;
+    hostsim::cost.flashEraseUs = 6000;
+    hostsim::cost.flashPageUs  = 2500;
+
+    modbusTCP.holdingRegisterWrite(Reg::SPEED_SELECT, 2);
+    modbusTCP.holdingRegisterWrite(Reg::TRAY_SELECT,  6);
+    loop();
+    uint64_t erases = hostsim::counters.flashRowErases;
+    uint64_t bytes  = hostsim::counters.flashBytesWritten;
+    for (int i = 0; i < 10; i++) {
+        modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::START);
+        while (reg(Reg::STATE) != STATE_RUN1) gridScan();
+        for (int n = 0; n < 100; n++) gridScan();
+        modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::STOP);
+        for (int n = 0; n < 5; n++) gridScan();
+    }
+    std::printf("    flash: %llu row erases, %llu bytes; longest scan period %.2f ms\n",
+                static_cast<unsigned long long>(hostsim::counters.flashRowErases - erases),
+                static_cast<unsigned long long>(hostsim::counters.flashBytesWritten - bytes),
+                g_maxPeriodNs / 1e6);
+    ok &= check("10 records pending", reg(Reg::LOG_PENDING) == 10);
+    ok &= check("no scan period stretched by a commit",
+                g_maxPeriodNs <= SCAN_CYCLE_MS * 1000000ull + 100000);
+
+    // Poller stores the first 4, then power fails
+    uint16_t cursor = reg(Reg::LOG_CURSOR);
+    modbusTCP.holdingRegisterWrite(Reg::LOG_ACK, static_cast<uint16_t>(cursor + 3));
+    gridScan();
+    gridScan();                                  // ack marker committed
+    reboot();
+    ok &= check("after reboot: the 6 unsent records are back",
+                reg(Reg::LOG_PENDING) == 6 && reg(Reg::LOG_CURSOR) == cursor + 4);
+    std::vector<LogRecord> v = readLogWindow();
+    ok &= check("restored records keep their fields",
+                v.size() == 6 && v[0].tray == 6 && v[0].speed == 2 &&
+                v[0].reason == STOP_REASON_STOP && v[0].durationS == 2);
+
+    // Record numbering continues after the reboot
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::START);
+    while (reg(Reg::STATE) != STATE_RUN1) loop();
+    for (int n = 0; n < 60; n++) loop();
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::STOP);
+    for (int n = 0; n < 5; n++) loop();
+    v = readLogWindow();
+    ok &= check("new record numbered after the restored ones",
+                v.size() == 7 && v.back().seq == cursor + 10);
+
+    // Short slack: entries wait in the queue instead of overrunning
+    hostsim::cost.backplaneUs = 12000;          // one input read eats the slack
+    uint64_t bytesBefore = hostsim::counters.flashBytesWritten;
+    modbusTCP.holdingRegisterWrite(Reg::LOG_ACK, v.back().seq);
+    for (int n = 0; n < 20; n++) loop();
+    bool waited = hostsim::counters.flashBytesWritten == bytesBefore;
+    hostsim::cost.backplaneUs = 0;
+    for (int n = 0; n < 5; n++) loop();
+    ok &= check("commit waits while slack is short, then lands",
+                waited && hostsim::counters.flashBytesWritten > bytesBefore);
+
+    uint16_t lastAcked = v.back().seq;
+    reboot();
+    ok &= check("fully drained log stays drained across reboot",
+                reg(Reg::LOG_PENDING) == 0 && readLogWindow().empty());
+
+    // Only acks survive: numbering still continues, never reused
+    dropJournalRecords();
+    reboot();
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::START);
+    while (reg(Reg::STATE) != STATE_RUN1) loop();
+    for (int n = 0; n < 55; n++) loop();
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::STOP);
+    for (int n = 0; n < 3; n++) loop();
+    v = readLogWindow();
+    ok &= check("only acks left: next record follows the last ack",
+                v.size() == 1 && v[0].seq == lastAcked + 1);
+    modbusTCP.holdingRegisterWrite(Reg::LOG_ACK, v[0].seq);
+    for (int n = 0; n < 5; n++) loop();
+
+    // Wrap the journal several times; only unsent records come back
+    for (int i = 0; i < 3 * PROD_JOURNAL_ENTRIES / 2; i++) {
+        modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::START);
+        while (reg(Reg::STATE) != STATE_RUN1) loop();
+        for (int n = 0; n < 55; n++) loop();
+        modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::STOP);
+        for (int n = 0; n < 3; n++) loop();
+        if (i % 2 == 0) {
+            std::vector<LogRecord> w = readLogWindow();
+            if (!w.empty()) {
+                modbusTCP.holdingRegisterWrite(Reg::LOG_ACK, w.back().seq);
+                for (int n = 0; n < 3; n++) loop();
+            }
+        }
+    }
+    uint16_t pending = reg(Reg::LOG_PENDING);
+    uint16_t first   = reg(Reg::LOG_CURSOR);
+    reboot();
+    ok &= check("after journal wrap: same unsent records restored",
+                reg(Reg::LOG_PENDING) == pending && reg(Reg::LOG_CURSOR) == first);
+
+    // No poller at all: the ring overflows and the journal wraps past
+    // records that were never sent.  The loss count must survive too.
+    for (int i = 0; i < PROD_JOURNAL_ENTRIES + 20; i++) {
+        modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::START);
+        while (reg(Reg::STATE) != STATE_RUN1) loop();
+        for (int n = 0; n < 55; n++) loop();
+        modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::STOP);
+        for (int n = 0; n < 3; n++) loop();
+    }
+    uint16_t lost = reg(Reg::LOG_LOST);
+    first = reg(Reg::LOG_CURSOR);
+    reboot();
+    ok &= check("unsent records lost stay counted across reboot",
+                lost > PROD_JOURNAL_ENTRIES - LOG_DEPTH && reg(Reg::LOG_LOST) == lost &&
+                reg(Reg::LOG_PENDING) == LOG_DEPTH && reg(Reg::LOG_CURSOR) == first);
+
+    hostsim::cost.flashEraseUs = 0;
+    hostsim::cost.flashPageUs  = 0;
+    return ok ? 0 : 1;
+}
+
+// ── Command mailbox ─────────────────────────────────────────────────────
+/** Queue one mailbox command the way a PC client would (one FC16). */
+void mailbox(uint16_t seq, int op, int16_t arg = 0) {
+    int base = Reg::MAILBOX_BASE + (seq % MAILBOX_DEPTH) * Reg::MAILBOX_WORDS;
+    modbusTCP.holdingRegisterWrite(base + 1, static_cast<uint16_t>(op));
+    modbusTCP.holdingRegisterWrite(base + 2, static_cast<uint16_t>(arg));
+    modbusTCP.holdingRegisterWrite(base + 3, CMD_PENDING);
+    modbusTCP.holdingRegisterWrite(base,     seq);
+}
+
+uint16_t mailboxResult(uint16_t seq) {
+    return reg(Reg::MAILBOX_BASE + (seq % MAILBOX_DEPTH) * Reg::MAILBOX_WORDS + 3);
+}
+
+int testMailbox() {
+    std::printf("mailbox: %d-slot command queue in registers %d-%d\n", MAILBOX_DEPTH,
+                Reg::MBX_LAST_SEQ, Reg::MAILBOX_BASE + MAILBOX_DEPTH * Reg::MAILBOX_WORDS - 1);
+    bool ok = true;
+    loop();
+    int  wait = reg(Reg::WAIT_TIME);
+
+    // A whole start-up queued at once runs in one scan, in order
+    mailbox(1, Cmd::SELECT_SPEED, 2);
+    mailbox(2, Cmd::SELECT_TRAY,  3);
+    mailbox(3, Cmd::TIMER_ADJUST, -5);
+    mailbox(4, Cmd::START);
+    loop();
+    ok &= check("4 pipelined commands run in one scan",
+                reg(Reg::MBX_LAST_SEQ) == 4 && reg(Reg::MBX_LAST_RESULT) == CMD_OK &&
+                mailboxResult(1) == CMD_OK && mailboxResult(4) == CMD_OK &&
+                reg(Reg::STATE) == STATE_BUZZER_DELAY && reg(Reg::SPEED_SELECTED) == 2 &&
+                reg(Reg::SELECTED_TRAY) == 3 && reg(Reg::WAIT_TIME) == wait - 5);
+    ok &= check("selections written back to 101-102",
+                reg(Reg::SPEED_SELECT) == 2 && reg(Reg::TRAY_SELECT) == 3);
+
+    // START then STOP in the same scan: both run (Reg::COMMAND keeps one)
+    for (int i = 0; i < 200; i++) loop();
+    mailbox(5, Cmd::STOP);
+    mailbox(6, Cmd::START);
+    loop();
+    ok &= check("STOP then START in one scan both act",
+                mailboxResult(5) == CMD_OK && mailboxResult(6) == CMD_OK &&
+                reg(Reg::STATE) == STATE_BUZZER_DELAY && reg(Reg::TRACE_COUNT) >= 4);
+
+    mailbox(7, Cmd::ESTOP_CLEAR);
+    mailbox(8, 99);
+    mailbox(9, Cmd::SELECT_SPEED, 9);
+    mailbox(10, Cmd::COUNT_SOURCE, 1);
+    loop();
+    ok &= check("results: refused, bad opcode, bad argument, ok",
+                mailboxResult(7) == CMD_REFUSED && mailboxResult(8) == CMD_BAD_OPCODE &&
+                mailboxResult(9) == CMD_BAD_ARG && mailboxResult(10) == CMD_OK &&
+                reg(Reg::SPEED_SELECTED) == 2 && reg(Reg::COUNT_SOURCE) == 1);
+    loop();
+    ok &= check("count source set by mailbox is not undone by 106",
+                reg(Reg::COUNT_SOURCE) == 1);
+
+    // 12 waits for 11; a stale entry in 11's slot is not run
+    mailbox(12, Cmd::TIMER_ADJUST, 1);
+    mailbox(11 - MAILBOX_DEPTH, Cmd::TIMER_ADJUST, 100);
+    loop();
+    ok &= check("gap in sequence: nothing runs", reg(Reg::MBX_LAST_SEQ) == 10 &&
+                mailboxResult(12) == CMD_PENDING);
+    mailbox(11, Cmd::TIMER_ADJUST, 2);
+    loop();
+    ok &= check("gap filled: 11 and 12 run in order",
+                reg(Reg::MBX_LAST_SEQ) == 12 && reg(Reg::WAIT_TIME) == wait - 5 + 3);
+
+    // Flash-writing commands queued back to back: one per scan, and
+    // what follows them keeps its place in the queue
+    mailbox(13, Cmd::SAVE_TIMER);
+    mailbox(14, Cmd::SAVE_CALIB);
+    mailbox(15, Cmd::RESET_TOTAL);
+    mailbox(16, Cmd::TIMER_ADJUST, 1);
+    bool onePerScan = true;
+    for (uint16_t expect : { 13, 14, 16 }) {
+        loop();
+        onePerScan &= reg(Reg::MBX_LAST_SEQ) == expect;
+    }
+    ok &= check("one flash-writing command per scan, order kept",
+                onePerScan && mailboxResult(15) == CMD_OK && mailboxResult(16) == CMD_OK &&
+                reg(Reg::WAIT_TIME) == wait - 5 + 4);
+
+    // Sequence 65535 is followed by 1
+    uint16_t seq = 16;
+    while (seq != 0xFFFF) {
+        for (int k = 0; k < MAILBOX_DEPTH && seq != 0xFFFF; k++) mailbox(++seq, Cmd::NONE);
+        loop();
+    }
+    mailbox(1, Cmd::STOP);
+    loop();
+    ok &= check("sequence wraps past 0",
+                reg(Reg::MBX_LAST_SEQ) == 1 && mailboxResult(1) == CMD_OK &&
+                reg(Reg::STATE) == STATE_STOP);
+
+    mailbox(2, Cmd::COUNT_SOURCE, 0);
+    loop();
+    return ok ? 0 : 1;
+}
+
+// ── Wall clock over a simulated 50-day run ──────────────────────────────
+constexpr uint32_t CLOCK_TEST_EPOCH = 1767225600u;     // 2026-01-01 00:00:00 UTC
+constexpr int32_t  CLOCK_TEST_SKEW  = 150;             // board oscillator, ppm fast
+constexpr uint64_t DAY_NS           = 86400ull * 1000000000ull;
+constexpr uint64_t HOUR_NS          = 3600ull * 1000000000ull;
+
+/** The PC's idea of the time, in epoch milliseconds. */
+uint64_t pcEpochMs(int64_t stepS = 0) {
+    return CLOCK_TEST_EPOCH * 1000ull + hostsim::nowNs() / 1000000u + stepS * 1000;
+}
+
+uint32_t clockNowReg() {
+    return reg(Reg::CLOCK_NOW_L) | (static_cast<uint32_t>(reg(Reg::CLOCK_NOW_H)) << 16);
+}
+
+uint32_t newestTraceTime() {
+    int slot = (reg(Reg::TRACE_COUNT) - 1) % TRACE_DEPTH;
+    int base = Reg::TRACE_BASE + slot * Reg::TRACE_ENTRY_WORDS;
+    return reg(base) | (static_cast<uint32_t>(reg(base + 1)) << 16);
+}
+
+/** Set the firmware clock from the PC, the way a sync task would. */
+void pcSync(int64_t stepS) {
+    uint64_t ms  = pcEpochMs(stepS);
+    uint32_t sec = static_cast<uint32_t>(ms / 1000);
+    modbusTCP.holdingRegisterWrite(Reg::CLOCK_SET_L,  sec & 0xFFFF);
+    modbusTCP.holdingRegisterWrite(Reg::CLOCK_SET_H,  sec >> 16);
+    modbusTCP.holdingRegisterWrite(Reg::CLOCK_SET_MS, static_cast<uint16_t>(ms % 1000));
+    modbusTCP.holdingRegisterWrite(Reg::CLOCK_SYNC,   1);
+    loop();
+}
+
+/** Idle in STOP until true time `ns`: one scan every 5 s, which is all
+ *  the clock needs, then ordinary scans for the last stretch. */
+void idleUntil(uint64_t ns) {
+    while (hostsim::nowNs() + 5000000000ull < ns) { hostsim::advanceUs(5000000); loop(); }
+    while (hostsim::nowNs() < ns) loop();
+}
+
+/** Same, until millis() reaches `ms` (before it wraps). */
+void idleUntilMillis(uint32_t ms) {
+    while (millis() < ms) {
+        if (ms - millis() > 6000) hostsim::advanceUs(5000000);
+        loop();
+    }
+}
+
+uint32_t diffS(uint32_t a, uint64_t b) {
+    return a > b ? static_cast<uint32_t>(a - b) : static_cast<uint32_t>(b - a);
+}
+
+/** TIME_DELAY across the millis() wrap: RUN1 from 70 s before, the
+ *  60 s countdown from 30.5 s before, so the wrap falls mid-second. */
+bool clockWrapScenario() {
+    bool ok = true;
+    std::printf("  -- millis() wrap at %.2f days --\n",
+                ((1ull << 32) * 1000000ull / (1000000 + CLOCK_TEST_SKEW)) / 86400000.0);
+    idleUntilMillis(0xFFFFFFFFu - 69999u);
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::START);
+    for (int i = 0; i < 500 && reg(Reg::STATE) != STATE_RUN1; i++) loop();
+    while (millis() >= 0x80000000u && millis() < 0xFFFFFFFFu - 30499u) loop();
+
+    uint64_t t0 = hostsim::nowNs();
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::START_DELAY);
+    loop();
+    uint32_t prev = clockNowReg();
+    uint16_t beat = reg(Reg::HEARTBEAT);
+    bool     steady = true;
+    int      beats  = 0;
+    for (int i = 0; i < 5000 && reg(Reg::STATE) == STATE_TIME_DELAY; i++) {
+        loop();
+        uint32_t now = clockNowReg();
+        if (now < prev || now > prev + 1) steady = false;
+        prev = now;
+        if (reg(Reg::HEARTBEAT) != beat) { beat = reg(Reg::HEARTBEAT); beats++; }
+    }
+    double delayS = (hostsim::nowNs() - t0) / 1e9;
+    ok &= check("countdown across the wrap still takes 60 s",
+                millis() < 0x80000000u && reg(Reg::STATE) == STATE_RUN2 &&
+                delayS > 59.9 && delayS < 61.5);
+    ok &= check("clock and heartbeat run on through the wrap", steady && beats >= 55);
+    ok &= check("trace timestamp after the wrap is real time",
+                diffS(newestTraceTime(), pcEpochMs() / 1000) <= 1);
+
+    for (int i = 0; i < 200; i++) loop();
+    ok &= check("start sequence after the wrap closes every motor",
+                (hostsim::relayOutputs() & MOTOR_ALL_MASK) == MOTOR_ALL_MASK);
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::STOP);
+    loop();
+    return ok;
+}
+
+int testClock() {
+    std::printf("clock: 50 simulated days, oscillator %+d ppm fast, PC sync once a day\n",
+                CLOCK_TEST_SKEW);
+    bool ok = true;
+    hostsim::setClockSkewPpm(CLOCK_TEST_SKEW);
+
+    ok &= check("unset clock counts seconds since boot",
+                reg(Reg::CLOCK_STATUS) == CLOCK_UNSET && clockNowReg() < 5);
+
+    modbusTCP.holdingRegisterWrite(Reg::CLOCK_SET_L,  12345);
+    modbusTCP.holdingRegisterWrite(Reg::CLOCK_SET_H,  0);
+    modbusTCP.holdingRegisterWrite(Reg::CLOCK_SET_MS, 0);
+    modbusTCP.holdingRegisterWrite(Reg::CLOCK_SYNC,   1);
+    loop();
+    ok &= check("set time below CLOCK_EPOCH_MIN refused",
+                reg(Reg::CLOCK_STATUS) == CLOCK_UNSET && clockNowReg() < 5);
+
+    int trayReg = Reg::TRAY_TIME_BASE + (4 - 1) * NUM_SPEEDS + (5 - 1);
+    modbusTCP.holdingRegisterWrite(trayReg, 500);
+    modbusTCP.holdingRegisterWrite(Reg::SAVE_CALIB, 1);
+    modbusTCP.holdingRegisterWrite(Reg::SPEED_SELECT, 5);
+    modbusTCP.holdingRegisterWrite(Reg::TRAY_SELECT,  4);
+    loop();
+
+    const uint64_t wrapMs  = (1ull << 32) * 1000000ull / (1000000 + CLOCK_TEST_SKEW);
+    const int      wrapDay = static_cast<int>(wrapMs / 86400000u);
+
+    int  worstOffset = 0;
+    bool stepsIgnored = true, stampsReal = true;
+    for (int d = 0; d <= 50; d++) {
+        idleUntil(d * DAY_NS);
+        int64_t step   = d == 30 ? 3600 : 0;     // the PC's clock is an hour out for a day
+        int16_t before = static_cast<int16_t>(reg(Reg::CLOCK_DRIFT));
+        pcSync(step);
+        int16_t offset = static_cast<int16_t>(reg(Reg::CLOCK_OFFSET_MS));
+        int16_t drift  = static_cast<int16_t>(reg(Reg::CLOCK_DRIFT));      // ppm ×10
+
+        if (d == 0)
+            ok &= check("first sync sets the clock",
+                        reg(Reg::CLOCK_STATUS) == CLOCK_SYNCED &&
+                        clockNowReg() == pcEpochMs() / 1000);
+        if (d == 1) {
+            std::printf("    day 1: %d ms off, drift %.1f ppm\n", offset, drift / 10.0);
+            ok &= check("day 1: 13 s fast, drift learned from it",
+                        offset < -12900 && offset > -13000 &&
+                        drift >= -1501 && drift <= -1499 &&
+                        reg(Reg::CLOCK_STATUS) == CLOCK_TRIMMED);
+        }
+        if (d == 30 || d == 31) stepsIgnored &= drift == before;
+        else if (d >= 3 && std::abs(offset) > worstOffset) worstOffset = std::abs(offset);
+
+        // Morning shift: a short run closes a production record
+        idleUntil(d * DAY_NS + 8 * HOUR_NS);
+        modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::START);
+        for (int i = 0; i < 500 && reg(Reg::STATE) != STATE_RUN1; i++) loop();
+        for (int i = 0; i < 1500; i++) loop();
+        modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::STOP);
+        loop();
+        uint32_t pcNow = static_cast<uint32_t>(pcEpochMs(step) / 1000);
+        std::vector<LogRecord> v = readLogWindow();
+        if (v.empty() || diffS(v.back().time, pcNow) > 1 || diffS(newestTraceTime(), pcNow) > 1)
+            stampsReal &= d == 0;                // no drift estimate yet: 4 s fast by 08:00
+        if (!v.empty()) ackLog(v.back().seq);
+
+        if (d == wrapDay) ok &= clockWrapScenario();
+    }
+    std::printf("    worst daily error after day 3: %d ms (uncorrected %d ms)\n",
+                worstOffset, CLOCK_TEST_SKEW * 864 / 10);
+    ok &= check("drift correction keeps a day's error under 20 ms", worstOffset < 20);
+    ok &= check("1 h steps of the PC clock leave the drift alone", stepsIgnored);
+    ok &= check("log records and trace carry real time every day", stampsReal);
+
+    idleUntil(50 * DAY_NS + 20 * HOUR_NS);
+    ok &= check("20 h after the last sync still within 1 s",
+                diffS(clockNowReg(), pcEpochMs() / 1000) <= 1);
+
+    modbusTCP.holdingRegisterWrite(Reg::COMMAND, Cmd::RESET_CURRENT);
+    for (int i = 0; i < 60; i++) loop();
+    uint32_t batch = reg(Reg::BATCH_START_L) | (static_cast<uint32_t>(reg(Reg::BATCH_START_H)) << 16);
+    ok &= check("batch start time published", diffS(batch, pcEpochMs() / 1000) <= 2);
+
+    // A PC with a reset RTC: 2^64 ns out, so a ms × 10^9 product would wrap
+    // to a plausible drift
+    int16_t driftBefore = static_cast<int16_t>(reg(Reg::CLOCK_DRIFT));
+    pcSync(18446744);
+    ok &= check("213-day step of the PC clock leaves the drift alone",
+                static_cast<int16_t>(reg(Reg::CLOCK_DRIFT)) == driftBefore &&
+                reg(Reg::CLOCK_STATUS) == CLOCK_TRIMMED);
+
+    hostsim::setClockSkewPpm(0);
+    return ok ? 0 : 1;
+}
+
+void usage() {
+    std::printf("usage: bonnie_host selftest counter|photoeye|inputs|trace|ramp|startseq|prodlog\n"
+                "                             journal|mailbox|clock [--hours H]\n");
+}
+
+} // namespace
+
+int runSelfTest(int argc, char** argv) {
+    if (argc < 1) { usage(); return 2; }
+    std::string test = argv[0];
+    double hours = 2.0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "--hours" && i + 1 < argc) hours = std::atof(argv[++i]);
+        else { usage(); return 2; }
+    }
+
+    hostsim::setRealtime(false);
+    hostsim::setSerialEcho(false);
+    hostsim::cost.ethPollUs = 500;      // bounds the scheduler's slack loop
+    hostsim::setInputs(IDLE_INPUTS);
+    setup();
+
+    if (test == "counter")  return testCounter(hours);
+    if (test == "photoeye") return testPhotoEye(hours);
+    if (test == "inputs")   return testInputs();
+    if (test == "trace")    return testTrace();
+    if (test == "ramp")     return testRamp();
+    if (test == "startseq") return testStartSequence();
+    if (test == "prodlog")  return testProductionLog();
+    if (test == "journal")  return testJournal();
+    if (test == "mailbox")  return testMailbox();
+    if (test == "clock")    return testClock();
+    usage();
+    return 2;
+}
@@ -0,0 +1,86 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+/**
+ * @file Arduino.h
+ * @brief Host stand-in for the Arduino core used by src/main.cpp
+ *
+ * Only the subset of the API the firmware touches is provided.  Time is
+ * driven by the simulated clock in HostSim.cpp, so delay() returns
+ * immediately and a benchmark can run hours of scans in seconds.
+ *
+ * NOTE: on the SAMD21 `unsigned long` is 32 bits; on a 64-bit host it
+ * is not.  millis()/micros() are declared uint32_t here so they wrap at
+ * 2^32 and subtract modulo 2^32 exactly like the target; firmware that
+ * keeps a timestamp in an `unsigned long` breaks at the wrap on the host
+ * as a reminder to use uint32_t.
+ */
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+typedef uint8_t byte;
+
+constexpr int DEC = 10;
+constexpr int HEX = 16;
+
+uint32_t millis();
+uint32_t micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// Flash-string helper — plain literals on the host
+#define F(s) (s)
+
+// ── Print / Serial ──────────────────────────────────────────────────────
+class Printable;
+
+class Print {
+public:
+    virtual ~Print() = default;
+    virtual size_t write(const char* s, size_t n) = 0;
+
+    size_t print(const char* s)                  { return write(s, std::strlen(s)); }
+    size_t print(char c)                         { return write(&c, 1); }
+    size_t print(int v, int base = DEC)          { return print(static_cast<long>(v), base); }
+    size_t print(unsigned int v, int base = DEC) { return print(static_cast<unsigned long>(v), base); }
+    size_t print(long v, int base = DEC);
+    size_t print(unsigned long v, int base = DEC);
+    size_t print(double v, int digits = 2);
+    size_t print(const Printable& p);
+
+    size_t println()                             { return write("\n", 1); }
+    template <typename T>
+    size_t println(const T& v)                   { size_t n = print(v); return n + println(); }
+    template <typename T>
+    size_t println(const T& v, int fmt)          { size_t n = print(v, fmt); return n + println(); }
+};
+
+class Printable {
+public:
+    virtual ~Printable() = default;
+    virtual size_t printTo(Print& p) const = 0;
+};
+
+class HardwareSerial : public Print {
+public:
+    void begin(unsigned long) {}
+    explicit operator bool() const { return true; }
+    size_t write(const char* s, size_t n) override;
+};
+
+extern HardwareSerial Serial;
+
+// ── IPAddress ───────────────────────────────────────────────────────────
+class IPAddress : public Printable {
+public:
+    IPAddress() : _a{0, 0, 0, 0} {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _a{a, b, c, d} {}
+    uint8_t operator[](int i) const { return _a[i]; }
+    size_t printTo(Print& p) const override;
+private:
+    uint8_t _a[4];
+};
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,40 @@
+#ifndef HOST_ARDUINO_MODBUS_H
+#define HOST_ARDUINO_MODBUS_H
+
+/**
+ * @file ArduinoModbus.h
+ * @brief Host stand-in for ArduinoModbus' ModbusTCPServer
+ *
+ * The register maps live in this object, as they do in libmodbus.
+ * poll() services at most one queued request from the currently
+ * accepted client, like the real server.
+ */
+
+#include "Arduino.h"
+#include "Ethernet.h"
+
+#include <vector>
+
+class ModbusTCPServer {
+public:
+    int  begin(int id = 0xff);
+    void accept(Client& client);
+    int  poll();
+
+    int  configureHoldingRegisters(int startAddress, int nb);
+    int  configureDiscreteInputs(int startAddress, int nb);
+
+    long holdingRegisterRead(int address);
+    int  holdingRegisterWrite(int address, uint16_t value);
+    long discreteInputRead(int address);
+    int  discreteInputWrite(int address, uint8_t value);
+
+private:
+    Client*               _client = nullptr;
+    int                   _hrStart = 0;
+    std::vector<uint16_t> _hr;
+    int                   _diStart = 0;
+    std::vector<uint8_t>  _di;
+};
+
+#endif // HOST_ARDUINO_MODBUS_H
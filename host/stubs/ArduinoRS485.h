@@ -0,0 +1,5 @@
+#ifndef HOST_ARDUINO_RS485_H
+#define HOST_ARDUINO_RS485_H
+// Host stand-in — ArduinoModbus pulls this in; nothing is used directly.
+#include "Arduino.h"
+#endif // HOST_ARDUINO_RS485_H
@@ -0,0 +1,72 @@
+#ifndef HOST_ETHERNET_H
+#define HOST_ETHERNET_H
+
+/**
+ * @file Ethernet.h
+ * @brief Host stand-in for the Arduino Ethernet (W5500) library
+ *
+ * Sockets are simulated connections owned by HostSim.cpp.  As on the
+ * real library, EthernetServer::available() returns any connected
+ * client that has unread data (not only new connections), and
+ * accept() returns each new connection exactly once.
+ */
+
+#include "Arduino.h"
+
+constexpr int MAX_SOCK_NUM = 8;   // W5500 hardware sockets
+
+class Client {
+public:
+    virtual ~Client() = default;
+    virtual uint8_t connected() = 0;
+    virtual int     available() = 0;
+    virtual void    stop() = 0;
+    virtual explicit operator bool() = 0;
+};
+
+class EthernetClient : public Client {
+public:
+    EthernetClient() : _sock(MAX_SOCK_NUM) {}
+    explicit EthernetClient(uint8_t sock) : _sock(sock) {}
+
+    uint8_t connected() override;
+    int     available() override;
+    void    stop() override;
+    explicit operator bool() override { return _sock < MAX_SOCK_NUM; }
+
+    bool operator==(const EthernetClient& o) const { return _sock == o._sock; }
+    bool operator!=(const EthernetClient& o) const { return _sock != o._sock; }
+
+    uint8_t getSocketNumber() const { return _sock; }
+
+    // stop() here closes at once; the real one waits up to this long
+    void setConnectionTimeout(uint16_t ms) { _timeout = ms; }
+
+private:
+    uint8_t  _sock;
+    uint16_t _timeout{ 1000 };
+};
+
+class EthernetServer {
+public:
+    explicit EthernetServer(uint16_t port) : _port(port) {}
+    void           begin();
+    EthernetClient available();
+    EthernetClient accept();
+private:
+    uint16_t _port;
+};
+
+class EthernetClass {
+public:
+    void      init(uint8_t csPin);
+    int       begin(uint8_t* mac, IPAddress ip, IPAddress dns,
+                    IPAddress gateway, IPAddress subnet);
+    IPAddress localIP() const { return _ip; }
+private:
+    IPAddress _ip;
+};
+
+extern EthernetClass Ethernet;
+
+#endif // HOST_ETHERNET_H
@@ -0,0 +1,59 @@
+#ifndef HOST_FLASH_STORAGE_H
+#define HOST_FLASH_STORAGE_H
+
+/**
+ * @file FlashStorage.h
+ * @brief Host stand-in for cmaglie/FlashStorage (SAMD21 NVM)
+ *
+ * Flash areas are declared `static const` exactly as on the target.
+ * HostSim keeps a writable mirror of each area (registered when its
+ * FlashClass is constructed) with SAMD21 semantics: erase works on
+ * 256-byte rows and sets bytes to 0xFF, programming can only clear bits.
+ * Firmware must therefore go through FlashClass::read(), not a raw
+ * pointer.  Every row erase is counted in HostSim so wear can be measured.
+ */
+
+#include "Arduino.h"
+
+class FlashClass {
+public:
+    static constexpr uint32_t ROW_SIZE  = 256;
+    static constexpr uint32_t PAGE_SIZE = 64;
+
+    FlashClass(const void* flash_addr = nullptr, uint32_t size = 0);
+
+    void write(const void* data) { write(flash_address, data, flash_size); }
+    void erase()                 { erase(flash_address, flash_size);       }
+    void read(void* data)        { read(flash_address, data, flash_size);  }
+
+    void write(const volatile void* flash_ptr, const void* data, uint32_t size);
+    void erase(const volatile void* flash_ptr, uint32_t size);
+    void read(const volatile void* flash_ptr, void* data, uint32_t size);
+
+private:
+    const volatile void* flash_address;
+    const uint32_t       flash_size;
+};
+
+template <class T>
+class FlashStorageClass {
+public:
+    explicit FlashStorageClass(const void* flash_addr) : flash(flash_addr, sizeof(T)) {}
+    void write(T data) { flash.erase(); flash.write(&data); }
+    void read(T* data) { flash.read(data); }
+    T    read()        { T data; read(&data); return data; }
+private:
+    FlashClass flash;
+};
+
+// Same shape as the library macros; storage starts zeroed, as it does
+// in a freshly programmed image.
+#define Flash(name, size)                                                   \
+    alignas(256) static const uint8_t name##_flashData[((size) + 255) / 256 * 256] = {}; \
+    FlashClass name(name##_flashData, size);
+
+#define FlashStorage(name, T)                                               \
+    alignas(256) static const uint8_t name##_flashData[(sizeof(T) + 255) / 256 * 256] = {}; \
+    FlashStorageClass<T> name(name##_flashData);
+
+#endif // HOST_FLASH_STORAGE_H
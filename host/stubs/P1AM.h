@@ -0,0 +1,32 @@
+#ifndef HOST_P1AM_H
+#define HOST_P1AM_H
+
+/**
+ * @file P1AM.h
+ * @brief Host stand-in for the P1AM backplane library
+ *
+ * Signatures follow facts-engineering/P1AM (data first, then slot and
+ * channel).  Module I/O lands in the simulated backplane in HostSim.cpp,
+ * which counts every transaction and can charge a modelled SPI cost to
+ * the simulated clock.
+ */
+
+#include "Arduino.h"
+
+#define HOLD   0
+#define TOGGLE 1
+
+class P1AM {
+public:
+    uint8_t  init();
+    uint32_t readDiscrete(uint8_t slot, uint8_t channel = 0);
+    void     writeDiscrete(uint32_t data, uint8_t slot, uint8_t channel = 0);
+    int      readAnalog(uint8_t slot, uint8_t channel);
+    void     writeAnalog(uint32_t data, uint8_t slot, uint8_t channel);
+    void     configWD(uint16_t milliseconds, uint8_t toggle);
+    void     petWD();
+};
+
+extern P1AM P1;
+
+#endif // HOST_P1AM_H
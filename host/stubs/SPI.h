@@ -0,0 +1,5 @@
+#ifndef HOST_SPI_H
+#define HOST_SPI_H
+// Host stand-in — the simulated backplane (P1AM.h) does not need SPI.
+#include "Arduino.h"
+#endif // HOST_SPI_H
@@ -31,7 +31,8 @@ constexpr uint8_t BIT_START       = 0;  // Ch 1 — Start        (NO)
 constexpr uint8_t BIT_STOP        = 1;  // Ch 2 — Stop         (NC, active LOW)
 constexpr uint8_t BIT_START_DELAY = 2;  // Ch 3 — Start Delay  (NO)
 constexpr uint8_t BIT_ESTOP       = 3;  // Ch 4 — E-Stop       (NC, active LOW)
-// Channels 5-16 available for expansion
+constexpr uint8_t BIT_PHOTO_EYE   = 4;  // Ch 5 — Plant photo-eye (ON = plant in beam)
+// Channels 6-16 available for expansion
 
 // =========================================================================
 // Relay Output Bit Positions  (P1-16TR  —  Slot 2)
@@ -109,6 +110,13 @@ constexpr MotorDef MOTOR_DEFS[NUM_MOTORS] = {
     { BIT_MOTOR8, ACH_MOTOR8 },   // idx 6 — Motor 8 Upper Soil Belt
 };
 
+// Ready-to-write outputs for one (speed, tray) combination, compiled
+// from the calibration factors so the scan loop does no float math.
+struct MotorProfile {
+    uint16_t dac[NUM_MOTORS];       // 12-bit DAC code per motor
+    uint32_t counterTicks;          // micros() ticks between plant counts
+};
+
 // Tray names (for serial logging only)
 constexpr const char* TRAY_NAMES[NUM_TRAYS] = {
     "6-06", "3.5", "4.5", "5", "Gallon", "8"
@@ -123,7 +131,28 @@ enum SystemState : uint8_t {
     STATE_TIME_DELAY   = 2,
     STATE_RUN2         = 3,
     STATE_ESTOP        = 4,
-    STATE_BUZZER_DELAY = 5
+    STATE_BUZZER_DELAY = 5,
+    STATE_ANY          = 0xFF   // transition table wildcard
+};
+
+// Events fed to the transition table (dispatchEvent)
+enum StateEvent : uint8_t {
+    EV_BOOT        = 0,
+    EV_START       = 1,
+    EV_STOP        = 2,
+    EV_START_DELAY = 3,
+    EV_ESTOP       = 4,
+    EV_ESTOP_CLEAR = 5,
+    EV_BUZZER_DONE = 6,     // BUZZER_PRE_SEC warning elapsed
+    EV_DELAY_DONE  = 7      // TIME_DELAY countdown reached 0
+};
+
+// Where an event came from (recorded in the transition trace)
+enum EventSource : uint8_t {
+    SRC_BOOT   = 0,
+    SRC_BUTTON = 1,         // P1-16ND3 input
+    SRC_HMI    = 2,         // Reg::COMMAND
+    SRC_TIMER  = 3
 };
 
 // =========================================================================
@@ -132,11 +161,67 @@ enum SystemState : uint8_t {
 constexpr float    BASE_SPEED_PCT       = 100.0f;  // 100 % = 10 V
 constexpr int      DEFAULT_WAIT_TIME    = 60;       // seconds
 constexpr int      BUZZER_PRE_SEC       = 3;        // buzzer duration (sec)
-constexpr int      COUNTER_BATCH_SIZE   = 100;      // flash writes per N counts
-constexpr uint32_t CALIB_MAGIC          = 0xBEEFCAFEu;
+constexpr int      COUNTER_BATCH_SIZE   = 10;       // journal a record every N counts
+constexpr int      COUNTER_MAX_CATCHUP  = 4;        // counts per scan; any backlog carries over
+constexpr uint16_t CALIB_SPEED_FACTOR_MAX = 2000;   // ×1000: motor / M8 factor ≤ 2.000
+constexpr uint16_t CALIB_TRAY_TIME_MIN  = 100;      // ×1000: ≥ 0.1 s per count
+constexpr uint16_t CALIB_TRAY_TIME_MAX  = 60000;    // ×1000: ≤ 60 s per count
+constexpr int      FLASH_ROW_BYTES      = 256;      // SAMD21 NVM erase unit
 constexpr unsigned long SCAN_CYCLE_MS   = 20;       // main loop target period
+constexpr uint8_t  SCAN_AVG_SHIFT       = 4;        // rolling scan average ≈ last 16 scans
 constexpr unsigned long HEARTBEAT_MS    = 1000;
 
+// Scan scheduling — how loop() waits out the rest of SCAN_CYCLE_MS
+//   SCAN_SCHED_DELAY    : delay() padding from the end of the last scan
+//                         (original behaviour; period drifts with jitter)
+//   SCAN_SCHED_DEADLINE : fixed period on absolute micros() deadlines;
+//                         the slack is spent answering Modbus requests
+// Both keep sampling the photo-eye (SENSOR_SAMPLE_US) while they wait.
+enum ScanScheduler : uint8_t {
+    SCAN_SCHED_DELAY    = 0,
+    SCAN_SCHED_DEADLINE = 1
+};
+constexpr ScanScheduler SCAN_SCHEDULER   = SCAN_SCHED_DEADLINE;
+constexpr uint32_t SLACK_GUARD_US       = 1000;     // stop slack polling this close to the deadline
+constexpr uint32_t SLACK_IDLE_US        = 200;      // pause between idle slack polls
+constexpr unsigned long OUTPUT_REFRESH_MS = 1000;   // rewrite every output anyway (0 = never)
+constexpr unsigned long STATUS_REFRESH_MS = 1000;   // rewrite every status register anyway (0 = never)
+
+// Plant counting source (Reg::COUNT_SOURCE)
+//   COUNT_SOURCE_TIMER  : one count per tray-time interval (estimate)
+//   COUNT_SOURCE_SENSOR : one count per photo-eye pulse on BIT_PHOTO_EYE
+// The photo-eye is sampled either way, so measured and estimated plant
+// rates can be compared and the timer model auto-calibrated.
+enum CountSource : uint8_t {
+    COUNT_SOURCE_TIMER  = 0,
+    COUNT_SOURCE_SENSOR = 1
+};
+// The P1-16ND3 has no interrupt line to the CPU, so while running the
+// photo-eye is sampled on its own micros() grid from the scan slack.
+constexpr uint32_t SENSOR_SAMPLE_US     = 2000;     // photo-eye sample period
+constexpr uint8_t  SENSOR_DEBOUNCE_SAMPLES = 3;     // equal samples to accept a change
+constexpr unsigned long RATE_UPDATE_MS  = 1000;     // measured / estimated rate refresh
+constexpr uint32_t AUTOCAL_MIN_COUNTS   = 50;       // photo-eye counts before auto-calibration
+constexpr uint8_t  FILTER_MAX_SCANS     = 8;        // input integrator limit (3-bit counters)
+constexpr uint8_t  TRACE_DEPTH          = 32;       // state transitions kept in RAM
+constexpr uint16_t RAMP_MAX_MS          = 30000;    // longest accel / decel ramp
+constexpr uint16_t START_STEP_MAX_MS    = 10000;    // longest start sequence step delay
+constexpr uint8_t  LOG_DEPTH            = 64;       // production records kept in RAM
+constexpr uint8_t  LOG_WINDOW_RECORDS   = 12;       // readout block 780-903 = one 124-register read
+constexpr uint8_t  JOURNAL_QUEUE        = 8;        // journal entries waiting for slack time
+constexpr uint32_t JOURNAL_COMMIT_US    = 10000;    // worst case commit: row erase + page write
+constexpr uint8_t  MAILBOX_DEPTH        = 8;        // command mailbox slots
+constexpr uint32_t CLOCK_DRIFT_MIN_MS   = 3600000;  // sync interval needed to estimate drift
+constexpr int16_t  CLOCK_MAX_DRIFT_PPM  = 2000;     // larger errors are clock steps, not drift
+constexpr uint32_t CLOCK_EPOCH_MIN      = 1000000000u;  // lowest accepted set time; below it, times are since boot
+
+// Wall clock state (Reg::CLOCK_STATUS)
+enum ClockStatus : uint8_t {
+    CLOCK_UNSET   = 0,      // never synced, time is seconds since boot
+    CLOCK_SYNCED  = 1,      // set by the PC / HMI, no drift estimate yet
+    CLOCK_TRIMMED = 2       // set, and drift correction applied
+};
+
 // =========================================================================
 // Network Configuration  (P1AM-ETH shield, WIZnet W5500)
 // =========================================================================
@@ -150,6 +235,18 @@ constexpr uint8_t  DEFAULT_SUBNET[4]  = { 255, 255, 255, 0 };
 constexpr uint8_t  DEFAULT_GATEWAY[4] = { 192, 168, 1, 1 };
 constexpr int      MODBUS_TCP_PORT    = 502;
 
+// Modbus TCP sessions — the W5500 has 8 hardware sockets; one is kept
+// free so the server can always listen for the next connection.
+constexpr int      MODBUS_MAX_CLIENTS      = 7;
+constexpr int      MODBUS_REQS_PER_SCAN    = 4;      // per client, per scan (fairness)
+constexpr unsigned long MODBUS_IDLE_TIMEOUT_MS = 30000; // drop sessions silent this long
+// EthernetClient::stop() waits this long for the peer to acknowledge the
+// FIN, then closes the socket anyway.  The library default is 1000 ms; a
+// dead or unplugged peer never acknowledges, so every close would stall
+// the scan (outputs, E-STOP, deadline) for that long.  Each close costs
+// at most this much.
+constexpr uint16_t MODBUS_CLOSE_TIMEOUT_MS = 5;
+
 // =========================================================================
 // Modbus TCP Register Map  (Holding Registers — FC 03 / 06)
 //
@@ -170,8 +267,13 @@ namespace Reg {
     constexpr int TOTAL_CTR_H       = 7;   // lifetime counter (high 16)
     constexpr int SELECTED_TRAY     = 8;   // 1-6 (0 = none)
     constexpr int HEARTBEAT         = 9;   // toggles each second
-    constexpr int INPUT_STATE       = 10;  // raw P1-16ND3 bitmask
+    constexpr int INPUT_STATE       = 10;  // filtered P1-16ND3 bitmask
     constexpr int OUTPUT_STATE      = 11;  // raw P1-16TR  bitmask
+    constexpr int STATUS_SEQ        = 12;  // +1 whenever 0-11, 13-20 or the discrete inputs change
+    constexpr int STATUS_COUNT      = 12;  // registers 0-11 mirrored from firmware state
+    //  Ramp position: 13 + motor index, DAC code being written (0-4095)
+    constexpr int RAMP_POS_BASE     = 13;
+    constexpr int START_SEQ_STEP    = 20;  // start sequence steps done, 0-7 (7 = all started)
 
     // --- Command Block (HMI writes, Arduino reads & clears) ---
     constexpr int COMMAND           = 100; // one-shot command code
@@ -180,6 +282,36 @@ namespace Reg {
     constexpr int TIMER_ADJUST      = 103; // signed +/-  (one-shot)
     constexpr int SAVE_TIMER        = 104; // 1 = save    (one-shot)
     constexpr int RESET_TOTAL       = 105; // 1 = reset   (one-shot)
+    constexpr int COUNT_SOURCE      = 106; // CountSource (persistent)
+    constexpr int AUTO_CALIB        = 107; // 1 = tray time from photo-eye (one-shot)
+
+    // --- Clock Block (PC / HMI sets, Arduino keeps time between syncs) ---
+    //  Write CLOCK_SET_L/H/MS, then 1 to CLOCK_SYNC.  The set time is
+    //  taken when CLOCK_SYNC is seen, so write it as late as possible.
+    constexpr int CLOCK_SET_L       = 110; // UTC epoch seconds to set (low 16)
+    constexpr int CLOCK_SET_H       = 111; //                          (high 16)
+    constexpr int CLOCK_SET_MS      = 112; // milliseconds into that second, 0-999
+    constexpr int CLOCK_SYNC        = 113; // 1 = apply CLOCK_SET (one-shot)
+    constexpr int CLOCK_NOW_L       = 114; // current epoch seconds (low 16), each second
+    constexpr int CLOCK_NOW_H       = 115; //                       (high 16)
+    constexpr int CLOCK_STATUS      = 116; // ClockStatus
+    constexpr int CLOCK_DRIFT       = 117; // signed: correction applied to millis(), ppm ×10
+    constexpr int CLOCK_OFFSET_MS   = 118; // signed: set − kept time at the last sync, saturating
+
+    // --- Command Mailbox (PC / HMI queues, Arduino drains in order) ---
+    //  Command with sequence s goes in slot s % MAILBOX_DEPTH, MAILBOX_WORDS
+    //  words from MAILBOX_BASE:
+    //    +0     sequence (1-65535, wraps past 0); write it last, or all
+    //           words in one FC16 request
+    //    +1     opcode (Cmd::*)
+    //    +2     argument (signed)
+    //    +3     CmdResult, written by the Arduino
+    //  Only sequence MBX_LAST_SEQ + 1 runs next; read MBX_LAST_SEQ on
+    //  connect and number on from it.
+    constexpr int MBX_LAST_SEQ      = 120; // sequence of the last command run, 0 = none since boot
+    constexpr int MBX_LAST_RESULT   = 121; // its CmdResult
+    constexpr int MAILBOX_BASE      = 124; // 124-155
+    constexpr int MAILBOX_WORDS     = 4;
 
     // --- Calibration Block (read/write from HMI) ---
     //  Motor factors : 200 + motorIdx*6 + speedIdx   (42 regs, 200-241)
@@ -188,12 +320,98 @@ namespace Reg {
     constexpr int MOTOR_FACTORS_BASE  = 200;
     constexpr int TRAY_TIME_BASE      = 250;
     constexpr int TRAY_M8_BASE        = 300;
+    constexpr int MOTOR_FACTORS_COUNT = NUM_MOTORS * NUM_SPEEDS;  // 42
+    constexpr int TRAY_FACTORS_COUNT  = NUM_TRAYS  * NUM_SPEEDS;  // 36 per tray table
+    constexpr int CALIB_COUNT         = MOTOR_FACTORS_COUNT + 2 * TRAY_FACTORS_COUNT;
+    //  Input filter  : 340 + channel-1  filter time in ms (340-355)
+    constexpr int FILTER_MS_BASE      = 340;
+    constexpr int FILTER_MAJORITY     = 356; // bit n = channel n+1 uses 3-read majority
+    //  Motor ramps   : 360 + motor index  0 → full scale time in ms (360-366)
+    //                  370 + motor index  full scale → 0 time in ms (370-376)
+    constexpr int RAMP_ACCEL_BASE     = 360;
+    constexpr int RAMP_DECEL_BASE     = 370;
+    //  Start sequence: 380 + step  motor number started at that step (380-386)
+    //                  390 + step  ms to wait after that step (390-395)
+    constexpr int START_ORDER_BASE    = 380;
+    constexpr int START_DELAY_BASE    = 390;
     constexpr int SAVE_CALIB          = 400; // 1 = save calibration to flash
 
-    constexpr int TOTAL_REGISTERS     = 402; // 0-401 inclusive
+    // --- Diagnostics Block (Arduino writes, HMI / PC poller reads) ---
+    //  Stage and scan durations in microseconds, saturated at 65535.
+    //  Refreshed at the end of every scan.
+    constexpr int DIAG_MODBUS_US      = 500; // handleModbus()
+    constexpr int DIAG_INPUTS_US      = 501; // scanInputs()
+    constexpr int DIAG_HMI_US         = 502; // processHMICommands()
+    constexpr int DIAG_TIMERS_US      = 503; // countdown/counter/buzzer/heartbeat
+    constexpr int DIAG_OUTPUTS_US     = 504; // updateOutputs()
+    constexpr int DIAG_STATUS_US      = 505; // updateStatusRegisters()
+    constexpr int DIAG_SCAN_LAST_US   = 506; // last scan, total work time
+    constexpr int DIAG_SCAN_MAX_US    = 507; // worst scan since reset
+    constexpr int DIAG_SCAN_AVG_US    = 508; // rolling average (SCAN_AVG_SHIFT)
+    constexpr int DIAG_OVERRUNS_L     = 509; // scans over SCAN_CYCLE_MS (low 16)
+    constexpr int DIAG_OVERRUNS_H     = 510; // scans over SCAN_CYCLE_MS (high 16)
+    constexpr int DIAG_RESET          = 511; // 1 = clear max, overruns, counts (one-shot)
+    constexpr int DIAG_BP_WRITES_L    = 512; // backplane output writes issued (low 16)
+    constexpr int DIAG_BP_WRITES_H    = 513; //                                (high 16)
+    constexpr int DIAG_BP_SAVED_L     = 514; // writes skipped, value unchanged (low 16)
+    constexpr int DIAG_BP_SAVED_H     = 515; //                                 (high 16)
+
+    constexpr int DIAG_CLIENTS_ACTIVE = 516; // connected Modbus TCP sessions
+    constexpr int DIAG_CLIENTS_REJECT = 517; // connections refused, all sessions busy
+    constexpr int DIAG_CLIENTS_IDLE   = 518; // sessions dropped by idle timeout
+    constexpr int DIAG_INPUT_RAW      = 519; // unfiltered P1-16ND3 bitmask, this scan
+    //  Per-session request counters: 520 + slot*2 (low 16, high 16),
+    //  slots 0..MODBUS_MAX_CLIENTS-1, zeroed when a slot is reused
+    constexpr int DIAG_CLIENT_REQS_BASE = 520;
+
+    // --- Counting Block (Arduino writes, refreshed every RATE_UPDATE_MS) ---
+    //  Rates in plants per minute ×10, measured since the run / profile started
+    constexpr int RATE_MEASURED       = 540; // photo-eye
+    constexpr int RATE_ESTIMATED      = 541; // tray time factor
+    constexpr int SENSOR_COUNT_L      = 542; // photo-eye pulses since boot (low 16)
+    constexpr int SENSOR_COUNT_H      = 543; //                             (high 16)
+    constexpr int AUTOCAL_RESULT      = 544; // last AUTO_CALIB: factor ×1000, 0 = refused
+    constexpr int BATCH_START_L       = 545; // clock time the batch counter was reset (low 16)
+    constexpr int BATCH_START_H       = 546; //                                        (high 16)
+
+    // --- Input Glitch Counters (cleared by DIAG_RESET) ---
+    //  560 + channel-1: disturbances the input filter suppressed, saturating
+    constexpr int DIAG_GLITCH_BASE    = 560;
+
+    // --- State Transition Trace (Arduino writes, HMI reads) ---
+    //  Ring of the last TRACE_DEPTH transitions.  The newest entry is at
+    //  slot (TRACE_COUNT - 1) % TRACE_DEPTH; each slot is
+    //  TRACE_ENTRY_WORDS words:
+    //    +0/+1  clock seconds at the transition (see CLOCK_NOW), low / high 16 bits
+    //    +2     source << 8 | event
+    //    +3     from state << 8 | to state
+    //    +4     milliseconds into that second, 0-999
+    constexpr int TRACE_COUNT         = 600; // transitions since boot (wraps at 65536)
+    constexpr int TRACE_BASE          = 604;
+    constexpr int TRACE_ENTRY_WORDS   = 5;   // 604-763
+
+    // --- Production Log Readout (see ProductionRecord) ---
+    //  The window shows the oldest LOG_WINDOW_RECORDS unacknowledged
+    //  records, LOG_RECORD_WORDS words each (record sequence 0 = empty):
+    //    +0     record sequence (1-65535, wraps past 0)
+    //    +1/+2  clock seconds when the record closed (see CLOCK_NOW)
+    //    +3     tray << 8 | speed
+    //    +4     StopReason
+    //    +5/+6  batch count, low / high 16 bits
+    //    +7/+8  total count, low / high 16 bits
+    //    +9     run duration in seconds (saturating)
+    //  Writing a record's sequence to LOG_ACK drops it and every older one.
+    constexpr int LOG_PENDING         = 780; // unacknowledged records in the ring
+    constexpr int LOG_CURSOR          = 781; // sequence of the first window record, 0 = none
+    constexpr int LOG_ACK             = 782; // write: last sequence stored (Arduino clears)
+    constexpr int LOG_LOST            = 783; // records overwritten before ack (saturating)
+    constexpr int LOG_WINDOW_BASE     = 784;
+    constexpr int LOG_RECORD_WORDS    = 10;
+
+    constexpr int TOTAL_REGISTERS     = LOG_WINDOW_BASE + LOG_WINDOW_RECORDS * LOG_RECORD_WORDS;  // 904
 }
 
-// Command codes (written to Reg::COMMAND by HMI)
+// Command codes (written to Reg::COMMAND by HMI, or as a mailbox opcode)
 namespace Cmd {
     constexpr int NONE            = 0;
     constexpr int START           = 1;
@@ -202,31 +420,181 @@ namespace Cmd {
     constexpr int ESTOP           = 4;
     constexpr int ESTOP_CLEAR     = 5;
     constexpr int RESET_CURRENT   = 6;
+    // Mailbox only (the one-shot registers of the command block remain)
+    constexpr int TIMER_ADJUST    = 7;   // argument: signed seconds
+    constexpr int SAVE_TIMER      = 8;
+    constexpr int RESET_TOTAL     = 9;
+    constexpr int SAVE_CALIB      = 10;
+    constexpr int SELECT_SPEED    = 11;  // argument: 1-6
+    constexpr int SELECT_TRAY     = 12;  // argument: 1-6
+    constexpr int COUNT_SOURCE    = 13;  // argument: CountSource
+    constexpr int AUTO_CALIB      = 14;
 }
 
+// Outcome of a command (Reg::MAILBOX_BASE slot +3, Reg::MBX_LAST_RESULT)
+enum CmdResult : uint8_t {
+    CMD_PENDING    = 0,     // not run yet
+    CMD_OK         = 1,
+    CMD_REFUSED    = 2,     // not allowed now (state, too few counts)
+    CMD_BAD_OPCODE = 3,
+    CMD_BAD_ARG    = 4
+};
+
 // =========================================================================
-// Calibration Data (persisted in SAMD Flash via FlashStorage)
+// Calibration Data (working copy in RAM; persisted by the store below)
 // =========================================================================
 struct CalibrationData {
-    uint32_t magic;                          // CALIB_MAGIC when valid
     float    motorFactors[NUM_MOTORS][NUM_SPEEDS];
     float    trayTimeFactors[NUM_TRAYS][NUM_SPEEDS];
     float    trayMotor8Factors[NUM_TRAYS][NUM_SPEEDS];
     int      waitTime;
 };
 
-struct CounterData {
-    uint32_t magic;
+// Input filter, run over the whole P1-16ND3 mask every scan
+//   integrator : a change is accepted once the input has disagreed with
+//                the filtered state for scans[ch] consecutive scans
+//   majority   : the filtered state is the majority of the last 3 reads
+struct InputFilterConfig {
+    uint8_t  scans[16];         // 1 (unfiltered) .. FILTER_MAX_SCANS
+    uint16_t majorityMask;      // bit n set → channel n+1 uses majority
+};
+
+// Speed ramps per motor: time for the DAC to travel the full 0-10 V
+// range, 0 = step immediately.  E-STOP never ramps.
+struct RampConfig {
+    uint16_t accelMs[NUM_MOTORS];
+    uint16_t decelMs[NUM_MOTORS];
+};
+
+// Motor start sequence: relays close one step at a time so their
+// inrush currents do not add up.  order[] holds motor indices (0-6).
+struct StartSequence {
+    uint8_t  order[NUM_MOTORS];
+    uint16_t delayMs[NUM_MOTORS - 1];   // after step k, before step k+1
+};
+
+// Why a production record was closed
+enum StopReason : uint8_t {
+    STOP_REASON_DELAY_DONE = 1,     // TIME_DELAY finished, batch counter reset
+    STOP_REASON_HMI_RESET  = 2,     // Cmd::RESET_CURRENT, batch counter reset
+    STOP_REASON_STOP       = 3,     // STOP button / command, batch continues
+    STOP_REASON_ESTOP      = 4      // E-STOP, batch continues
+};
+
+// One production log entry (RAM ring, Reg::LOG_* readout)
+struct ProductionRecord {
+    uint32_t timestamp;             // clock seconds when closed (Reg::CLOCK_NOW)
+    uint32_t batchCount;            // currentCounter when closed
+    uint32_t totalCount;
+    uint16_t durationS;             // since the run (re)started, saturating
+    uint16_t sequence;              // 1-65535, never 0
+    uint8_t  tray;                  // 1-6, 0 = none
+    uint8_t  speed;                 // 1-6, 0 = none
+    uint8_t  reason;                // StopReason
+    uint8_t  reserved;
+};
+
+// =========================================================================
+// Calibration Store (schema 2 — sectioned, CRC32-checked, A/B copies)
+//
+// Each section is committed on its own: saving the wait timer rewrites
+// only the timer record.  Every section owns two flash rows and writes
+// alternate between them, so a torn write (power loss mid-save) leaves
+// the previous copy intact; on boot the valid copy with the highest
+// sequence wins.  Schema 1 (a single FlashStorage image) is not read:
+// the upload that brings schema 2 erases it, so factory defaults load
+// until the HMI saves calibration again.
+// =========================================================================
+constexpr uint32_t CALIB_STORE_MAGIC    = 0xCA1B5EC7u;
+constexpr uint16_t CALIB_SCHEMA_VERSION = 2;
+
+enum CalibSection : uint8_t {
+    CALSEC_MOTOR     = 0,   // motorFactors
+    CALSEC_TRAY_TIME = 1,   // trayTimeFactors
+    CALSEC_TRAY_M8   = 2,   // trayMotor8Factors
+    CALSEC_TIMER     = 3,   // waitTime
+    CALSEC_FILTER    = 4,   // InputFilterConfig
+    CALSEC_RAMP      = 5,   // RampConfig
+    CALSEC_START     = 6,   // StartSequence
+    NUM_CALSEC
+};
+
+struct CalibRecordHeader {
+    uint32_t magic;         // CALIB_STORE_MAGIC
+    uint16_t schema;        // CALIB_SCHEMA_VERSION
+    uint8_t  section;       // CalibSection
+    uint8_t  reserved;
+    uint32_t sequence;      // +1 per commit of this section
+    uint16_t length;        // payload bytes that follow the header
+    uint16_t reserved2;
+    uint32_t crc;           // CRC32 of the fields above + payload
+};
+static_assert(sizeof(CalibRecordHeader) == 20, "CalibRecordHeader layout");
+
+// =========================================================================
+// Lifetime Counter Journal (wear-levelled, append-only)
+//
+// COUNTER_JOURNAL_ROWS flash rows of 256 bytes, written as a ring of
+// 16-byte records (4 per 64-byte page, so a record never straddles a
+// page).  Each save programs the next blank slot; a row is erased only
+// when the write pointer enters it.  On boot the valid record with the
+// highest sequence number holds the total.
+// =========================================================================
+constexpr uint32_t COUNTER_REC_MAGIC     = 0xC0C0A7E5u;
+constexpr int      COUNTER_JOURNAL_ROWS  = 8;
+
+struct CounterRecord {
+    uint32_t magic;         // COUNTER_REC_MAGIC; 0xFFFFFFFF = blank slot
+    uint32_t sequence;      // +1 per record, never reused
     uint32_t totalCounter;
+    uint32_t check;         // counterRecordCheck() — catches torn writes
+};
+static_assert(sizeof(CounterRecord) == 16, "CounterRecord must stay 16 bytes");
+
+constexpr int COUNTER_RECS_PER_ROW = FLASH_ROW_BYTES / sizeof(CounterRecord);
+constexpr int COUNTER_JOURNAL_RECS = COUNTER_JOURNAL_ROWS * COUNTER_RECS_PER_ROW;
+
+inline uint32_t counterRecordCheck(const CounterRecord& r) {
+    return ~(r.magic ^ (r.sequence * 0x9E3779B1u) ^ r.totalCounter);
+}
+
+// =========================================================================
+// Production Journal (append-only, flash)
+//
+// PROD_JOURNAL_ROWS flash rows written as a ring of 32-byte entries
+// (2 per 64-byte page).  An entry is either a ProductionRecord or an
+// acknowledgement marker naming the last record the poller stored.
+// Replaying the valid entries oldest-first on boot rebuilds the RAM
+// log with exactly the records that were never acknowledged.  Every
+// entry also carries LOG_LOST as it stood when committed, so records
+// whose row has been recycled are still counted after a reboot.
+// =========================================================================
+constexpr int      PROD_JOURNAL_ROWS     = 16;
+
+enum JournalKind : uint8_t {
+    JRN_RECORD = 1,
+    JRN_ACK    = 2          // record.sequence = last acknowledged record
 };
 
+struct ProdJournalEntry {
+    uint32_t         sequence;  // +1 per entry, never reused; 0xFFFFFFFF = blank
+    uint8_t          kind;      // JournalKind
+    uint8_t          reserved;
+    uint16_t         lost;      // LOG_LOST when committed
+    ProductionRecord record;
+    uint32_t         crc;       // CRC32 of everything above — catches torn writes
+};
+static_assert(sizeof(ProdJournalEntry) == 32, "ProdJournalEntry must stay 32 bytes");
+
+constexpr int PROD_ENTRIES_PER_ROW = FLASH_ROW_BYTES / sizeof(ProdJournalEntry);
+constexpr int PROD_JOURNAL_ENTRIES = PROD_JOURNAL_ROWS * PROD_ENTRIES_PER_ROW;
+
 // =========================================================================
 // Factory-Default Calibration Values
 // =========================================================================
 
 // All motor speed factors default to 1.0 (100 % of base speed)
 inline void loadFactoryDefaults(CalibrationData& d) {
-    d.magic = CALIB_MAGIC;
     for (int m = 0; m < NUM_MOTORS; m++)
         for (int s = 0; s < NUM_SPEEDS; s++)
             d.motorFactors[m][s] = 1.0f;
@@ -245,4 +613,32 @@ inline void loadFactoryDefaults(CalibrationData& d) {
     d.waitTime = DEFAULT_WAIT_TIME;
 }
 
+// Buttons ride out contact bounce (3 scans = 60 ms); a single noisy
+// read of the NC STOP / E-STOP loops is outvoted; the photo-eye has
+// its own sampler and debounce.
+inline void loadFilterDefaults(InputFilterConfig& f) {
+    for (int ch = 0; ch < 16; ch++) f.scans[ch] = 1;
+    f.scans[BIT_START]       = 3;
+    f.scans[BIT_START_DELAY] = 3;
+    f.majorityMask = (1u << BIT_STOP) | (1u << BIT_ESTOP);
+}
+
+// Belts start over 2 s and stop over 1 s, so trays and soil stay put
+inline void loadRampDefaults(RampConfig& r) {
+    for (int m = 0; m < NUM_MOTORS; m++) {
+        r.accelMs[m] = 2000;
+        r.decelMs[m] = 1000;
+    }
+}
+
+// Downstream belts first so nothing is fed onto a stopped belt; the
+// infeed (motor 1) last.
+inline void loadStartDefaults(StartSequence& q) {
+    static const uint8_t order[NUM_MOTORS] = {
+        5, 4, 3, 2, MOTOR_8_IDX, 1, 0       // motors 6 5 4 3 8 2 1
+    };
+    for (int k = 0; k < NUM_MOTORS; k++) q.order[k] = order[k];
+    for (int k = 0; k < NUM_MOTORS - 1; k++) q.delayMs[k] = 500;
+}
+
 #endif // CONFIG_H
@@ -9,7 +9,7 @@
  * I/O is accessed directly through the P1AM library (SPI backplane),
  * NOT through Modbus to the I/O modules.
  *
- * State machine:
+ * State machine (TRANSITIONS table, run by dispatchEvent()):
  *   STOP → (start) → BUZZER_DELAY → RUN1 → (delay btn) → TIME_DELAY
  *        → (timer done) → RUN2 → (delay btn) → TIME_DELAY → …
  *   Any state → (estop) → ESTOP → (clear) → BUZZER_DELAY → prior state
@@ -24,12 +24,39 @@
 #include <ArduinoRS485.h>
 #include <ArduinoModbus.h>
 #include <FlashStorage.h>
+#include <stddef.h>                     // offsetof
 
 #include "Config.h"
 
+// Scan-stage probe — the host build (host/) defines this to time each
+// stage of loop() on a workstation; on the P1AM it compiles to nothing.
+// Called from markStage() with the stage name.
+#ifndef SCAN_PROBE
+#define SCAN_PROBE(stage)
+#endif
+
+// Soft-float tally — the SAMD21 has no FPU, so the host build charges
+// each float operation at a cost measured on the target.  Nothing here.
+#ifndef SOFT_FLOAT_OPS
+#define SOFT_FLOAT_OPS(n)
+#endif
+
 // ── Flash Storage ───────────────────────────────────────────────────────
-FlashStorage(flashCalib,   CalibrationData);
-FlashStorage(flashCounter, CounterData);
+// Calibration store — two rows (A/B copy) per CalibSection.
+__attribute__((__aligned__(FLASH_ROW_BYTES)))
+static const uint8_t calibStoreData[NUM_CALSEC * 2 * FLASH_ROW_BYTES] = {};
+FlashClass calibStore(calibStoreData, sizeof(calibStoreData));
+
+// Lifetime counter journal — whole rows, row-aligned, in program flash.
+// Always read through counterJournal.read(), never the raw array.
+__attribute__((__aligned__(FLASH_ROW_BYTES)))
+static const uint8_t counterJournalData[COUNTER_JOURNAL_ROWS * FLASH_ROW_BYTES] = {};
+FlashClass counterJournal(counterJournalData, sizeof(counterJournalData));
+
+// Production record journal — same layout rules as the counter journal.
+__attribute__((__aligned__(FLASH_ROW_BYTES)))
+static const uint8_t prodJournalData[PROD_JOURNAL_ROWS * FLASH_ROW_BYTES] = {};
+FlashClass prodJournal(prodJournalData, sizeof(prodJournalData));
 
 // ── Ethernet / Modbus objects ───────────────────────────────────────────
 byte           mac[]  = { DEFAULT_MAC[0], DEFAULT_MAC[1], DEFAULT_MAC[2],
@@ -42,59 +69,207 @@ IPAddress      gateway(DEFAULT_GATEWAY[0], DEFAULT_GATEWAY[1],
 
 EthernetServer ethServer(MODBUS_TCP_PORT);
 ModbusTCPServer modbusTCP;
-EthernetClient  modbusClient;
+
+// One slot per connected Modbus TCP client (HMI, SCADA historian, …)
+struct ModbusSession {
+    EthernetClient client;
+    bool           active;
+    uint32_t       lastRequestMs;
+    uint32_t       requests;        // lifetime, published in diagnostics
+    uint8_t        scanRequests;    // this scan, capped by MODBUS_REQS_PER_SCAN
+};
+
+ModbusSession   sessions[MODBUS_MAX_CLIENTS] = {};
+uint8_t         nextSession          = 0;   // round-robin cursor
+uint16_t        sessionsRejected     = 0;
+uint16_t        sessionsTimedOut     = 0;
 
 // ── Calibration & Counter ───────────────────────────────────────────────
 CalibrationData calib;
+uint32_t        calibSeq[NUM_CALSEC]  = {};   // sequence of the live copy
+int8_t          calibCopy[NUM_CALSEC] = { -1, -1, -1, -1, -1, -1, -1 };  // live row, -1 = none
+uint32_t        calibCrc[NUM_CALSEC]  = {};   // CRC of the live copy
+uint16_t        calibRegs[Reg::CALIB_COUNT] = {};  // factor ×1000 last synced with the HMI
+bool            calibRegsValid       = false;  // false → push every register
+
+// ── Motor Profiles (compiled from calib, indexed [speed][tray]) ─────────
+MotorProfile    profiles[NUM_SPEEDS][NUM_TRAYS];
+uint8_t         profileDirty[NUM_SPEEDS] = {};  // per speed: bit t = tray t stale
 uint32_t        totalCounter         = 0;
 uint32_t        currentCounter       = 0;
 uint32_t        countersSinceFlush   = 0;
+int             journalNext          = 0;   // next slot to program
+uint32_t        journalSeq           = 0;   // sequence for the next record
 
 // ── State Machine ───────────────────────────────────────────────────────
 SystemState     currentState         = STATE_STOP;
 SystemState     previousState        = STATE_STOP;
 SystemState     estopReturnState     = STATE_STOP;
 
+// ── Transition Trace ────────────────────────────────────────────────────
+struct TraceEntry {
+    uint32_t    time;           // clock seconds
+    uint16_t    ms;             // 0-999 into that second
+    uint8_t     event;
+    uint8_t     source;
+    uint8_t     from;
+    uint8_t     to;
+};
+TraceEntry      trace[TRACE_DEPTH]   = {};
+uint16_t        traceCount           = 0;   // transitions since boot
+
 int             speedSelected        = 0;   // 1-6, 0 = none
 int             traySelected         = 0;   // 1-6, 0 = none
-float           motorSpeed[NUM_MOTORS] = {};
-uint16_t        outputState          = 0;   // P1-16TR bitmask
-uint16_t        prevInputs           = 0xFFFF; // NC default high
+uint16_t        motorDAC[NUM_MOTORS] = {};  // active profile, 0 = stopped
+uint16_t        outputState          = 0;   // P1-16TR bitmask, as commanded
+uint16_t        appliedRelays        = 0;   // outputState + motors still ramping down
+
+// ── Motor Ramps (DAC codes) ─────────────────────────────────────────────
+RampConfig      ramps;
+uint16_t        motorRamp[NUM_MOTORS]  = {};  // DAC code being written
+uint16_t        rampUpStep[NUM_MOTORS] = {};  // per scan
+uint16_t        rampDownStep[NUM_MOTORS] = {};
+
+// ── Start Sequence ──────────────────────────────────────────────────────
+StartSequence   startSeq;
+uint16_t        startPending         = 0;   // motor relays still to close
+uint8_t         startStep            = 0;   // next step of startSeq.order
+uint32_t        startStepMs          = 0;   // millis() the next step is due
+uint16_t        prevInputs           = 0xFFFF; // filtered, NC default high
+uint16_t        rawInputs            = 0;      // last read, as published (DIAG_INPUT_RAW)
+
+// ── Production Log (RAM ring, drained over Modbus) ──────────────────────
+ProductionRecord prodLog[LOG_DEPTH];
+uint8_t         logHead              = 0;   // oldest unacknowledged record
+uint8_t         logCount             = 0;   // unacknowledged records
+uint16_t        logNextSeq           = 1;
+uint16_t        logLost              = 0;
+bool            logWindowDirty       = true;
+bool            runOpen              = false;   // a record is being timed
+uint32_t        runStartMs           = 0;
+ProdJournalEntry jrnQueue[JOURNAL_QUEUE];       // waiting for slack time
+uint8_t         jrnQueued            = 0;
+int             jrnNext              = 0;   // next journal slot to program
+uint32_t        jrnSeq               = 1;   // sequence for the next entry
+
+// ── Input Filter (bit-sliced: bit n of each word is channel n+1) ────────
+InputFilterConfig inputFilter;
+uint16_t        filterCount[3]       = {};      // integrator counters, 3 bit planes
+uint16_t        filterLimit[3]       = {};      // scans-1 per channel, 3 bit planes
+uint16_t        filterHistory[2]     = { 0xFFFF, 0xFFFF };  // last two reads (majority)
+uint16_t        glitchCount[16]      = {};      // suppressed disturbances, saturating
+
+// ── Output Shadow (last values committed to the backplane) ──────────────
+uint16_t        committedRelays      = 0;
+uint16_t        committedDAC[NUM_MOTORS] = {};
+bool            outputShadowValid    = false;  // false → write everything
+uint32_t        lastOutputRefreshMs  = 0;
+uint32_t        backplaneWrites      = 0;
+uint32_t        backplaneWritesSaved = 0;
+
+// ── Status Publisher (what the HMI can currently read) ──────────────────
+uint16_t        publishedStatus[Reg::STATUS_COUNT] = {};
+uint16_t        publishedRamp[NUM_MOTORS] = {};
+uint8_t         publishedStartStep   = 0;
+uint16_t        publishedInputs      = 0;
+bool            statusShadowValid    = false;  // false → write everything
+uint32_t        lastStatusRefreshMs  = 0;
+uint16_t        statusSeq            = 0;
 
 // ── Timers (millis-based) ───────────────────────────────────────────────
 int             waitTime;                  // from calibration
 int             remainingTime        = 0;
-unsigned long   lastCountdownTick    = 0;
-unsigned long   lastCounterTick      = 0;
-unsigned long   counterIntervalMs    = 2000;
-
-unsigned long   buzzerStartMs        = 0;
+uint32_t        lastCountdownTick    = 0;
+uint32_t        counterLastUs        = 0;     // micros() at the last accumulation
+uint32_t        counterAccumUs       = 0;     // elapsed run time not yet counted
+uint32_t        counterIntervalUs    = 2000000;
+
+// ── Wall Clock (kept from millis(), set through Reg::CLOCK_*) ──────────
+uint32_t        clockSeconds         = 0;   // epoch seconds; since boot while unset
+uint16_t        clockMs              = 0;   // 0-999 into clockSeconds
+uint32_t        clockLastMs          = 0;   // millis() at the last tick
+int64_t         clockTrim            = 0;   // drift correction owed, ms × 1e-9
+int32_t         clockDriftPpb        = 0;   // added to every elapsed millis()
+uint32_t        clockRawMs           = 0;   // millis() elapsed since the last sync
+ClockStatus     clockStatus          = CLOCK_UNSET;
+uint32_t        publishedClock       = 0;
+uint32_t        batchStartTime       = 0;   // clock seconds the batch counter was reset
+
+// ── Photo-Eye Counting ──────────────────────────────────────────────────
+CountSource     countSource          = COUNT_SOURCE_TIMER;
+uint32_t        nextSensorSampleUs   = 0;
+bool            sensorLevel          = false;   // debounced photo-eye state
+uint8_t         sensorDisagree       = 0;       // consecutive samples ≠ sensorLevel
+uint32_t        sensorCount          = 0;       // debounced pulses since boot
+uint32_t        rateCounts           = 0;       // pulses since rateStartMs
+uint32_t        rateStartMs          = 0;       // run / profile start
+uint32_t        lastRateUpdateMs     = 0;
+uint16_t        rateMeasured         = 0;       // plants/min ×10
+uint16_t        rateEstimated        = 0;       // plants/min ×10
+
+uint32_t        buzzerStartMs        = 0;
 bool            buzzerSounding       = false;
 
-unsigned long   lastHeartbeatMs      = 0;
+uint32_t        lastHeartbeatMs      = 0;
 bool            heartbeatToggle      = false;
 
-unsigned long   lastScanMs           = 0;
+uint32_t        lastScanMs           = 0;     // SCAN_SCHED_DELAY
+uint32_t        nextScanUs           = 0;     // SCAN_SCHED_DEADLINE: next scan start
+
+// ── Scan Diagnostics (µs, published in the Reg::DIAG_* block) ───────────
+enum ScanStage : uint8_t {
+    STAGE_MODBUS = 0,
+    STAGE_INPUTS,
+    STAGE_HMI,
+    STAGE_TIMERS,
+    STAGE_OUTPUTS,
+    STAGE_STATUS,
+    NUM_STAGES
+};
+
+const char* const STAGE_NAMES[NUM_STAGES] = {
+    "handleModbus", "scanInputs", "processHMICommands",
+    "timers", "updateOutputs", "updateStatusRegisters"
+};
+
+uint16_t        stageUs[NUM_STAGES]  = {};
+uint32_t        scanStartUs          = 0;
+uint32_t        stageMarkUs          = 0;
+uint16_t        scanLastUs           = 0;
+uint16_t        scanMaxUs            = 0;
+uint32_t        scanAvgAccum         = 0;   // average << SCAN_AVG_SHIFT
+uint32_t        scanOverruns         = 0;
 
 // Previous HMI selections (for edge detection)
 int             prevHMISpeed         = 0;
 int             prevHMITray          = 0;
 
+// ── Command Mailbox ─────────────────────────────────────────────────────
+uint16_t        mbxLastSeq           = 0;   // last sequence run, 0 = none since boot
+bool            flashCmdRun          = false;  // a flash-writing command ran this scan
+
 // ── Forward Declarations ────────────────────────────────────────────────
 // State machine
+bool dispatchEvent(StateEvent ev, EventSource src);
+void recordTransition(StateEvent ev, EventSource src, SystemState from, SystemState to);
 void stateStop();
 void stateRun1();
 void stateTimeDelay();
 void stateRun2();
 void stateEstop();
 void stateBuzzerDelay();
-void stateTimeDelayComplete();
-void stateEstopCleared();
 
 // I/O
 void scanInputs();
 void updateOutputs();
+void rampMotors();
+void applyRamps();
 void setMotorSpeeds();
+void buildProfiles();
+void samplePhotoEye(uint16_t raw);
+uint16_t filterInputs(uint16_t raw);
+void applyInputFilter();
+void serviceSensorSampler();
 
 // Helpers
 void setOutputBit(uint8_t bit, bool on);
@@ -105,35 +280,82 @@ void setBuzzer(bool on);
 void allMotorsOn();
 void allMotorsOff();
 void partialMotorsOff();
+void handleStartSequence();
 
 // Timers
 void handleCountdownTimer();
 void handleCounterTimer();
+void handleCountRates();
+void countPlant();
 void handleBuzzerTimer();
 void handleHeartbeat();
+void handleClock();
+void tickClock();
+uint32_t clockNow();
+void syncClock();
+
+// Scheduling
+void waitForNextScan();
 
 // Modbus / HMI
 void handleModbus();
+void acceptModbusClients();
+void expireModbusClients();
+int  pollModbusSessions();
 void processHMICommands();
+CmdResult runCommand(int op, int16_t arg);
+bool commandWritesFlash(int op);
+bool flashCommandWaits(int op);
+void serviceMailbox();
 void updateStatusRegisters();
 void pushCalibrationToRegisters();
 void pullCalibrationFromRegisters();
+float& calibSlot(int i, int& reg);
+void markProfilesDirty(int i);
+bool calibValueValid(int i, long value);
+bool autoCalibrateTrayTime();
+void pushInputFilterToRegisters();
+void pullInputFilterFromRegisters();
+void pushRampsToRegisters();
+void pullRampsFromRegisters();
+void pushStartSequenceToRegisters();
+uint16_t motorNumber(int idx);
+void pullStartSequenceFromRegisters();
 
 // Persistence
 void loadCalibration();
 void saveCalibration();
+bool loadCalibSection(CalibSection sec);
+bool saveCalibSection(CalibSection sec);
+void calibSectionData(CalibSection sec, uint8_t*& data, uint16_t& length);
+uint32_t crc32Update(uint32_t crc, const void* data, size_t length);
 void loadCounter();
 void saveCounter();
+bool readCounterRecord(int slot, CounterRecord& rec);
+
+// Diagnostics
+uint16_t saturateU16(unsigned long v);
+void markStage(ScanStage stage);
+void finishScanDiagnostics();
 
 // Logging
-void logProductionRun();
+void logProductionRun(StopReason reason);
+void appendLogRecord(const ProductionRecord& r);
+bool dropLogThrough(uint16_t sequence);
+void serviceProductionLog();
+void publishLogWindow();
+void queueJournalEntry(JournalKind kind, const ProductionRecord& r);
+void commitJournalEntry();
+void evictJournalRow(int first);
+void loadProductionJournal();
+bool readJournalEntry(int slot, ProdJournalEntry& e);
 
 // =====================================================================
 //  SETUP
 // =====================================================================
 void setup() {
     Serial.begin(115200);
-    unsigned long t0 = millis();
+    uint32_t t0 = millis();
     while (!Serial && (millis() - t0 < 3000));  // wait for serial, max 3 s
 
     Serial.println(F("=== BonnieConveyor P1AM v1.0 ==="));
@@ -167,57 +389,229 @@ void setup() {
     // ── Load Calibration & Counter ──────────────────────────────────
     loadCalibration();
     loadCounter();
+    loadProductionJournal();
     waitTime      = calib.waitTime;
     remainingTime = waitTime;
+    for (int s = 0; s < NUM_SPEEDS; s++) profileDirty[s] = (1u << NUM_TRAYS) - 1;
+    buildProfiles();
+
+    applyInputFilter();
+    applyRamps();
 
     // Push factory/saved calibration into Modbus registers
     pushCalibrationToRegisters();
+    pushInputFilterToRegisters();
+    pushRampsToRegisters();
+    pushStartSequenceToRegisters();
 
     // ── Initial safe state ──────────────────────────────────────────
+    // First updateOutputs() writes every relay and DAC channel (shadow
+    // not yet valid), so all analog outputs start at 0.
     outputState = 0;
     updateOutputs();
-    for (int i = 0; i < NUM_MOTORS; i++) {
-        P1.writeAnalog(SLOT_AO, MOTOR_DEFS[i].analogCh, 0);
-    }
 
-    stateStop();
+    dispatchEvent(EV_BOOT, SRC_BOOT);
     Serial.println(F("=== Ready ==="));
+
+    lastScanMs = millis();
+    nextScanUs = micros();
 }
 
 // =====================================================================
 //  LOOP  —  deterministic scan cycle
 // =====================================================================
 void loop() {
+    scanStartUs = stageMarkUs = micros();
     P1.petWD();                         // reset watchdog
 
     handleModbus();                     // accept HMI connections, poll
+    markStage(STAGE_MODBUS);
     scanInputs();                       // read P1-16ND3, edge detect
+    markStage(STAGE_INPUTS);
     processHMICommands();               // read HMI command registers
+    markStage(STAGE_HMI);
 
     handleCountdownTimer();             // TimeDelay countdown
     handleCounterTimer();               // plant counter
+    handleCountRates();                 // measured vs estimated plant rate
     handleBuzzerTimer();                // buzzer pre-start delay
+    handleStartSequence();              // staggered motor relay closing
     handleHeartbeat();                  // heartbeat register toggle
+    handleClock();                      // wall clock, published each second
+    markStage(STAGE_TIMERS);
 
     updateOutputs();                    // write P1-16TR + P1-08DAL-2
+    markStage(STAGE_OUTPUTS);
     updateStatusRegisters();            // push status → Modbus registers
+    markStage(STAGE_STATUS);
+
+    finishScanDiagnostics();            // scan totals → diagnostics registers
+
+    waitForNextScan();                  // hold SCAN_CYCLE_MS period
+}
+
+// =====================================================================
+//  SCAN SCHEDULING
+// =====================================================================
+
+/** Wait out the remainder of the scan period (see SCAN_SCHEDULER). */
+void waitForNextScan() {
+    if (SCAN_SCHEDULER == SCAN_SCHED_DELAY) {
+        // Enforce minimum scan cycle for consistent timing
+        uint32_t elapsed = millis() - lastScanMs;
+        if (jrnQueued && elapsed * 1000 + JOURNAL_COMMIT_US < SCAN_CYCLE_MS * 1000) {
+            commitJournalEntry();
+            elapsed = millis() - lastScanMs;
+        }
+        if (elapsed < SCAN_CYCLE_MS) {
+            // Pad in short steps so the photo-eye keeps its own sample
+            // grid; Modbus still waits for the next scan in this mode
+            uint32_t padStart = micros();
+            uint32_t padUs    = (SCAN_CYCLE_MS - elapsed) * 1000UL;
+            while ((uint32_t)micros() - padStart < padUs) {
+                serviceSensorSampler();
+                delayMicroseconds(SLACK_IDLE_US);
+            }
+        }
+        lastScanMs = millis();
+        return;
+    }
 
-    // Enforce minimum scan cycle for consistent timing
-    unsigned long elapsed = millis() - lastScanMs;
-    if (elapsed < SCAN_CYCLE_MS) {
-        delay(SCAN_CYCLE_MS - elapsed);
+    // Deadline mode: scans start on a fixed micros() grid, so a late
+    // scan does not push every later scan back.
+    const uint32_t periodUs = SCAN_CYCLE_MS * 1000UL;
+    nextScanUs += periodUs;
+
+    int32_t late = (int32_t)((uint32_t)micros() - nextScanUs);
+    if (late >= 0) {
+        // Overran this period.  Start right away; after a whole missed
+        // period re-anchor the grid instead of bursting catch-up scans.
+        if (late >= (int32_t)periodUs) nextScanUs = micros();
+        return;
     }
-    lastScanMs = millis();
+
+    // Slack: answer HMI requests until close to the deadline.  Outputs
+    // are still only written by updateOutputs(), so they stay on the grid.
+    // A queued journal entry is committed only if a worst-case flash
+    // commit still ends before the guard.
+    while ((int32_t)(nextScanUs - (uint32_t)micros()) > (int32_t)SLACK_GUARD_US) {
+        serviceSensorSampler();
+        if (jrnQueued &&
+            (int32_t)(nextScanUs - (uint32_t)micros()) > (int32_t)(SLACK_GUARD_US + JOURNAL_COMMIT_US)) {
+            commitJournalEntry();
+            continue;
+        }
+        if (!pollModbusSessions()) delayMicroseconds(SLACK_IDLE_US);
+    }
+
+    int32_t rest = (int32_t)(nextScanUs - (uint32_t)micros());
+    if (rest > 0) delayMicroseconds((unsigned int)rest);
 }
 
 // =====================================================================
 //  STATE MACHINE
 // =====================================================================
 
+// ── Guards and transition actions ──────────────────────────────────
+bool notEstop()          { return currentState != STATE_ESTOP; }
+bool selectionMade()     { return speedSelected >= 1 && traySelected >= 1; }
+bool resumeStopped()     { return estopReturnState == STATE_STOP ||
+                                  estopReturnState == STATE_BUZZER_DELAY; }
+bool resumeTimeDelay()   { return estopReturnState == STATE_TIME_DELAY; }
+bool resumeRun2()        { return previousState == STATE_ESTOP &&
+                                  estopReturnState == STATE_RUN2; }
+
+void finishTimeDelay() {
+    logProductionRun(STOP_REASON_DELAY_DONE);
+    currentCounter = 0;
+    batchStartTime = clockNow();
+    Serial.println(F("TimeDelay done — counter reset"));
+}
+
+void clearEstopOutput() {
+    Serial.println(F("E-Stop cleared"));
+    setOutputBit(BIT_ESTOP_OUT, false);
+}
+
+/** One row per allowed transition.  dispatchEvent() takes the first
+ *  row whose state and event match and whose guard (if any) passes,
+ *  runs its action, then enters the target state.  An event with no
+ *  matching row is ignored.  E-STOP during the start warning returns
+ *  to STOP once cleared; from RUN1 / RUN2 it warns again and resumes. */
+struct Transition {
+    SystemState from;           // STATE_ANY matches every state
+    StateEvent  event;
+    bool      (*guard)();       // nullptr = always
+    void      (*action)();      // nullptr = none; runs before entry
+    SystemState to;
+};
+
+const Transition TRANSITIONS[] = {
+    { STATE_ANY,          EV_BOOT,        nullptr,         nullptr,          STATE_STOP         },
+    { STATE_ANY,          EV_ESTOP,       notEstop,        nullptr,          STATE_ESTOP        },
+    { STATE_ANY,          EV_STOP,        notEstop,        nullptr,          STATE_STOP         },
+    { STATE_STOP,         EV_START,       selectionMade,   nullptr,          STATE_BUZZER_DELAY },
+    { STATE_BUZZER_DELAY, EV_BUZZER_DONE, resumeRun2,      nullptr,          STATE_RUN2         },
+    { STATE_BUZZER_DELAY, EV_BUZZER_DONE, nullptr,         nullptr,          STATE_RUN1         },
+    { STATE_RUN1,         EV_START_DELAY, nullptr,         nullptr,          STATE_TIME_DELAY   },
+    { STATE_RUN2,         EV_START_DELAY, nullptr,         nullptr,          STATE_TIME_DELAY   },
+    { STATE_TIME_DELAY,   EV_DELAY_DONE,  nullptr,         finishTimeDelay,  STATE_RUN2         },
+    { STATE_ESTOP,        EV_ESTOP_CLEAR, resumeStopped,   clearEstopOutput, STATE_STOP         },
+    { STATE_ESTOP,        EV_ESTOP_CLEAR, resumeTimeDelay, clearEstopOutput, STATE_TIME_DELAY   },
+    { STATE_ESTOP,        EV_ESTOP_CLEAR, nullptr,         clearEstopOutput, STATE_BUZZER_DELAY },
+};
+
+// Entry action of each state, indexed by SystemState
+void (* const STATE_ENTRY[])() = {
+    stateStop, stateRun1, stateTimeDelay, stateRun2, stateEstop, stateBuzzerDelay
+};
+
+/** Run one event through the transition table.
+ *  @return true if a transition was taken */
+bool dispatchEvent(StateEvent ev, EventSource src) {
+    for (const Transition& t : TRANSITIONS) {
+        if (t.event != ev) continue;
+        if (t.from != STATE_ANY && t.from != currentState) continue;
+        if (t.guard && !t.guard()) continue;
+
+        SystemState from = currentState;
+        if (t.action) t.action();
+        previousState = from;
+        currentState  = t.to;
+        recordTransition(ev, src, from, t.to);
+        STATE_ENTRY[t.to]();
+        return true;
+    }
+    return false;
+}
+
+/** Append a transition to the RAM trace and its register slot. */
+void recordTransition(StateEvent ev, EventSource src, SystemState from, SystemState to) {
+    uint8_t     slot = traceCount % TRACE_DEPTH;
+    TraceEntry& e    = trace[slot];
+    tickClock();
+    e.time   = clockSeconds;
+    e.ms     = clockMs;
+    e.event  = ev;
+    e.source = src;
+    e.from   = from;
+    e.to     = to;
+    traceCount++;
+
+    int reg = Reg::TRACE_BASE + slot * Reg::TRACE_ENTRY_WORDS;
+    modbusTCP.holdingRegisterWrite(reg,     (uint16_t)(e.time & 0xFFFF));
+    modbusTCP.holdingRegisterWrite(reg + 1, (uint16_t)(e.time >> 16));
+    modbusTCP.holdingRegisterWrite(reg + 2, (uint16_t)(e.source << 8 | e.event));
+    modbusTCP.holdingRegisterWrite(reg + 3, (uint16_t)(e.from << 8 | e.to));
+    modbusTCP.holdingRegisterWrite(reg + 4, e.ms);
+    modbusTCP.holdingRegisterWrite(Reg::TRACE_COUNT, traceCount);
+}
+
+// ── State entry actions (currentState / previousState already set) ──
+
 void stateStop() {
-    previousState = currentState;
-    currentState  = STATE_STOP;
     Serial.println(F("State: STOP"));
+    if (runOpen) logProductionRun(STOP_REASON_STOP);
 
     if (countersSinceFlush > 0) { saveCounter(); countersSinceFlush = 0; }
 
@@ -228,8 +622,6 @@ void stateStop() {
 }
 
 void stateRun1() {
-    previousState = currentState;
-    currentState  = STATE_RUN1;
     Serial.println(F("State: RUN1"));
 
     setMotorSpeeds();
@@ -237,12 +629,12 @@ void stateRun1() {
     setGreenLight();
 
     // start counter timer
-    lastCounterTick = millis();
+    counterLastUs  = micros();
+    counterAccumUs = 0;
+    if (!runOpen) { runOpen = true; runStartMs = millis(); }
 }
 
 void stateTimeDelay() {
-    previousState = currentState;
-    currentState  = STATE_TIME_DELAY;
     Serial.println(F("State: TIME_DELAY"));
 
     partialMotorsOff();   // motors 1, 2, 8 off
@@ -254,33 +646,32 @@ void stateTimeDelay() {
 }
 
 void stateRun2() {
-    previousState = currentState;
-    currentState  = STATE_RUN2;
     Serial.println(F("State: RUN2"));
 
     setMotorSpeeds();
     allMotorsOn();
     setGreenLight();
 
-    lastCounterTick = millis();
+    counterLastUs  = micros();
+    counterAccumUs = 0;
+    if (!runOpen) { runOpen = true; runStartMs = millis(); }
 }
 
 void stateEstop() {
     estopReturnState = previousState;
-    previousState    = currentState;
-    currentState     = STATE_ESTOP;
     Serial.println(F("*** E-STOP ***"));
+    if (runOpen) logProductionRun(STOP_REASON_ESTOP);
 
     if (countersSinceFlush > 0) { saveCounter(); countersSinceFlush = 0; }
 
     allMotorsOff();
+    for (int i = 0; i < NUM_MOTORS; i++)
+        motorRamp[i] = 0;               // no deceleration ramp
     setRedLight();
     setOutputBit(BIT_ESTOP_OUT, true);
 }
 
 void stateBuzzerDelay() {
-    previousState = currentState;
-    currentState  = STATE_BUZZER_DELAY;
     Serial.println(F("State: BUZZER_DELAY"));
 
     buzzerStartMs  = millis();
@@ -288,28 +679,6 @@ void stateBuzzerDelay() {
     setBuzzer(true);
 }
 
-void stateTimeDelayComplete() {
-    logProductionRun();
-    currentCounter = 0;
-    Serial.println(F("TimeDelay done — counter reset"));
-    stateRun2();
-}
-
-void stateEstopCleared() {
-    Serial.println(F("E-Stop cleared"));
-    setOutputBit(BIT_ESTOP_OUT, false);
-
-    if (previousState == STATE_STOP) {
-        stateStop();
-    } else if (previousState == STATE_TIME_DELAY) {
-        stateTimeDelay();
-    } else {
-        // Was running — give buzzer warning before resuming
-        estopReturnState = previousState;  // RUN1 or RUN2
-        stateBuzzerDelay();
-    }
-}
-
 // =====================================================================
 //  OUTPUT HELPERS
 // =====================================================================
@@ -319,19 +688,42 @@ void setOutputBit(uint8_t bit, bool on) {
     else    outputState &= ~(1u << bit);
 }
 
+/** Start every motor that is off, one sequence step at a time
+ *  (handleStartSequence closes the relays). */
 void allMotorsOn() {
-    outputState |= MOTOR_ALL_MASK;
+    startPending = MOTOR_ALL_MASK & ~outputState;
+    startStep    = 0;
+    startStepMs  = millis();
 }
 
 void allMotorsOff() {
     outputState &= ~MOTOR_ALL_MASK;
+    startPending = 0;
+    startStep    = 0;
     for (int i = 0; i < NUM_MOTORS; i++)
-        motorSpeed[i] = 0.0f;
+        motorDAC[i] = 0;
 }
 
 void partialMotorsOff() {
     // Stop motors 1, 2, 8 during TimeDelay
-    outputState &= ~MOTOR_PARTIAL_MASK;
+    outputState  &= ~MOTOR_PARTIAL_MASK;
+    startPending &= ~MOTOR_PARTIAL_MASK;
+}
+
+/** Close the next relay of the start sequence when its step is due.
+ *  Steps for motors already running (or dropped by partialMotorsOff)
+ *  pass without a delay. */
+void handleStartSequence() {
+    while (startStep < NUM_MOTORS && (int32_t)(millis() - startStepMs) >= 0) {
+        uint16_t bit = 1u << MOTOR_DEFS[startSeq.order[startStep]].relayBit;
+        bool     due = startPending & bit;
+        if (due) {
+            outputState  |= bit;
+            startPending &= ~bit;
+        }
+        if (due && startStep < NUM_MOTORS - 1) startStepMs += startSeq.delayMs[startStep];
+        startStep++;
+    }
 }
 
 void setRedLight() {
@@ -360,89 +752,251 @@ void setBuzzer(bool on) {
 //  MOTOR SPEED CALCULATION
 // =====================================================================
 
+/** Load the profile for the selected speed / tray: DAC codes and
+ *  counter interval are table lookups, no float math. */
 void setMotorSpeeds() {
     if (speedSelected < 1 || speedSelected > NUM_SPEEDS) return;
     if (traySelected  < 1 || traySelected  > NUM_TRAYS)  return;
 
-    int si = speedSelected - 1;   // 0-based speed index
-    int ti = traySelected  - 1;   // 0-based tray  index
+    const MotorProfile& p = profiles[speedSelected - 1][traySelected - 1];
+    for (int m = 0; m < NUM_MOTORS; m++) motorDAC[m] = p.dac[m];
+    counterIntervalUs = p.counterTicks;
 
-    // Motors 1-6
-    for (int m = 0; m < NUM_MOTORS - 1; m++) {
-        motorSpeed[m] = BASE_SPEED_PCT * calib.motorFactors[m][si];
-    }
-    // Motor 8 uses tray-specific factor
-    motorSpeed[MOTOR_8_IDX] = BASE_SPEED_PCT * calib.trayMotor8Factors[ti][si];
+    // New run or profile: restart the measured-rate window
+    rateCounts  = 0;
+    rateStartMs = millis();
+}
 
-    // Update counter interval for this speed/tray combination
-    counterIntervalMs = static_cast<unsigned long>(
-        calib.trayTimeFactors[ti][si] * 1000.0f);
-    if (counterIntervalMs < 100) counterIntervalMs = 100;  // floor
+/** Recompile the profiles flagged in profileDirty from calib.
+ *  Runs at boot and when a calibration save changed factors. */
+void buildProfiles() {
+    for (int si = 0; si < NUM_SPEEDS; si++) {
+        if (!profileDirty[si]) continue;
+
+        // Motors 1-6 depend on speed only: convert once per speed
+        uint16_t speedDAC[NUM_MOTORS - 1];
+        for (int m = 0; m < NUM_MOTORS - 1; m++)
+            speedDAC[m] = percentToDAC(BASE_SPEED_PCT * calib.motorFactors[m][si]);
+        SOFT_FLOAT_OPS(6 * (NUM_MOTORS - 1));
+
+        for (int ti = 0; ti < NUM_TRAYS; ti++) {
+            if (!(profileDirty[si] & (1u << ti))) continue;
+            MotorProfile& p = profiles[si][ti];
+
+            for (int m = 0; m < NUM_MOTORS - 1; m++) p.dac[m] = speedDAC[m];
+            // Motor 8 uses tray-specific factor
+            p.dac[MOTOR_8_IDX] = percentToDAC(BASE_SPEED_PCT * calib.trayMotor8Factors[ti][si]);
+
+            // Counter interval for this speed/tray combination
+            uint32_t ticks = static_cast<uint32_t>(calib.trayTimeFactors[ti][si] * 1000000.0f + 0.5f);
+            p.counterTicks = ticks < 100000 ? 100000 : ticks;   // floor 100 ms
+            SOFT_FLOAT_OPS(6 + 3);
+        }
+        profileDirty[si] = 0;
+    }
 }
 
 // =====================================================================
 //  PHYSICAL I/O
 // =====================================================================
 
+/** Move each motor's DAC code one scan's step toward its target: the
+ *  profile value while its relay is commanded on, 0 otherwise.  A motor
+ *  decelerating to 0 keeps its relay closed until it gets there. */
+void rampMotors() {
+    uint16_t hold = 0;
+    for (int i = 0; i < NUM_MOTORS; i++) {
+        uint16_t bit    = 1u << MOTOR_DEFS[i].relayBit;
+        uint16_t target = (outputState & bit) ? motorDAC[i] : 0;
+        uint16_t pos    = motorRamp[i];
+
+        if (pos < target)
+            pos = (target - pos > rampUpStep[i]) ? pos + rampUpStep[i] : target;
+        else if (pos > target)
+            pos = (pos - target > rampDownStep[i]) ? pos - rampDownStep[i] : target;
+
+        motorRamp[i] = pos;
+        if (pos > 0) hold |= bit;
+    }
+    appliedRelays = outputState | hold;
+}
+
+/** Convert ramp times to DAC codes per scan (rounded up, so a ramp
+ *  never takes longer than configured on an on-time scan). */
+void applyRamps() {
+    for (int i = 0; i < NUM_MOTORS; i++) {
+        uint16_t up   = ramps.accelMs[i];
+        uint16_t down = ramps.decelMs[i];
+        if (up   > RAMP_MAX_MS) up   = ramps.accelMs[i] = RAMP_MAX_MS;
+        if (down > RAMP_MAX_MS) down = ramps.decelMs[i] = RAMP_MAX_MS;
+        rampUpStep[i]   = up   ? (uint16_t)((DAC_MAX * SCAN_CYCLE_MS + up   - 1) / up)   : DAC_MAX;
+        rampDownStep[i] = down ? (uint16_t)((DAC_MAX * SCAN_CYCLE_MS + down - 1) / down) : DAC_MAX;
+    }
+}
+
+/** Write relays and DAC channels that differ from what the backplane
+ *  last received.  Every OUTPUT_REFRESH_MS everything is rewritten in
+ *  case a module lost its state (hot swap, base brown-out). */
 void updateOutputs() {
-    // Write all 16 relay outputs atomically
-    P1.writeDiscrete(SLOT_DO, outputState);
+    rampMotors();
+
+    bool refresh = !outputShadowValid ||
+                   (OUTPUT_REFRESH_MS > 0 && millis() - lastOutputRefreshMs >= OUTPUT_REFRESH_MS);
+    if (refresh) {
+        outputShadowValid   = true;
+        lastOutputRefreshMs = millis();
+    }
+
+    // All 16 relay outputs in one transaction  (P1AM API: data, slot)
+    if (refresh || appliedRelays != committedRelays) {
+        P1.writeDiscrete(appliedRelays, SLOT_DO);
+        committedRelays = appliedRelays;
+        backplaneWrites++;
+    } else {
+        backplaneWritesSaved++;
+    }
 
-    // Write analog speed values for each motor
+    // Analog speed values for each motor
     for (int i = 0; i < NUM_MOTORS; i++) {
-        // Only write non-zero if the relay is on
-        bool relayOn = outputState & (1u << MOTOR_DEFS[i].relayBit);
-        int  dacVal  = relayOn ? percentToDAC(motorSpeed[i]) : 0;
-        P1.writeAnalog(SLOT_AO, MOTOR_DEFS[i].analogCh, dacVal);
+        uint16_t dacVal = motorRamp[i];
+        if (refresh || dacVal != committedDAC[i]) {
+            P1.writeAnalog(dacVal, SLOT_AO, MOTOR_DEFS[i].analogCh);
+            committedDAC[i] = dacVal;
+            backplaneWrites++;
+        } else {
+            backplaneWritesSaved++;
+        }
     }
 }
 
 void scanInputs() {
     uint16_t raw = static_cast<uint16_t>(P1.readDiscrete(SLOT_DI));
+    uint16_t in  = filterInputs(raw);
+    if (raw != rawInputs) {
+        rawInputs = raw;
+        modbusTCP.holdingRegisterWrite(Reg::DIAG_INPUT_RAW, raw);
+    }
 
     // ── START button (NO — rising edge) ─────────────────────────────
-    if ((raw & (1u << BIT_START)) && !(prevInputs & (1u << BIT_START))) {
-        if (currentState == STATE_STOP) {
-            if (speedSelected >= 1 && traySelected >= 1) {
-                stateBuzzerDelay();
-            } else {
-                Serial.println(F("Start ignored: select speed & tray first"));
-            }
-        }
+    if ((in & (1u << BIT_START)) && !(prevInputs & (1u << BIT_START))) {
+        if (!dispatchEvent(EV_START, SRC_BUTTON) && currentState == STATE_STOP)
+            Serial.println(F("Start ignored: select speed & tray first"));
     }
 
     // ── STOP button (NC — falling edge = activated) ─────────────────
-    if (!(raw & (1u << BIT_STOP)) && (prevInputs & (1u << BIT_STOP))) {
-        if (currentState != STATE_ESTOP) {
-            stateStop();
-        }
+    if (!(in & (1u << BIT_STOP)) && (prevInputs & (1u << BIT_STOP))) {
+        dispatchEvent(EV_STOP, SRC_BUTTON);
     }
 
     // ── START DELAY button (NO — rising edge) ───────────────────────
-    if ((raw & (1u << BIT_START_DELAY)) && !(prevInputs & (1u << BIT_START_DELAY))) {
-        if (currentState == STATE_RUN1 || currentState == STATE_RUN2) {
-            stateTimeDelay();
-        }
+    if ((in & (1u << BIT_START_DELAY)) && !(prevInputs & (1u << BIT_START_DELAY))) {
+        dispatchEvent(EV_START_DELAY, SRC_BUTTON);
     }
 
     // ── E-STOP (NC — falling edge = activated) ──────────────────────
-    if (!(raw & (1u << BIT_ESTOP)) && (prevInputs & (1u << BIT_ESTOP))) {
-        stateEstop();
+    if (!(in & (1u << BIT_ESTOP)) && (prevInputs & (1u << BIT_ESTOP))) {
+        dispatchEvent(EV_ESTOP, SRC_BUTTON);
     }
 
     // ── E-STOP released (NC — rising edge = cleared) ────────────────
-    if ((raw & (1u << BIT_ESTOP)) && !(prevInputs & (1u << BIT_ESTOP))) {
-        if (currentState == STATE_ESTOP) {
-            stateEstopCleared();
+    if ((in & (1u << BIT_ESTOP)) && !(prevInputs & (1u << BIT_ESTOP))) {
+        dispatchEvent(EV_ESTOP_CLEAR, SRC_BUTTON);
+    }
+
+    prevInputs = in;
+    // Discrete-input mirror for the HMI is published by updateStatusRegisters()
+
+    samplePhotoEye(raw);      // own sampler and debounce
+}
+
+/** One scan of the input filter over all 16 channels at once.
+ *  Integrator channels keep a 3-bit counter of consecutive reads that
+ *  disagree with the filtered state, held as bit planes so the whole
+ *  mask updates with a handful of word operations; a change is
+ *  accepted when the counter reaches the channel's scans-1.  Majority
+ *  channels take the majority of the last three reads.  A disturbance
+ *  that dies out before it is accepted counts as a glitch. */
+uint16_t filterInputs(uint16_t raw) {
+    const uint16_t maj  = inputFilter.majorityMask;
+    uint16_t&      c0   = filterCount[0];
+    uint16_t&      c1   = filterCount[1];
+    uint16_t&      c2   = filterCount[2];
+
+    // Integrator
+    uint16_t diff    = raw ^ prevInputs;
+    uint16_t atLimit = ~((c0 ^ filterLimit[0]) | (c1 ^ filterLimit[1]) | (c2 ^ filterLimit[2]));
+    uint16_t accept  = diff & atLimit;
+    uint16_t glitch  = (c0 | c1 | c2) & ~diff;          // was pending, gone again
+    uint16_t inc     = diff & ~accept & ~maj;
+    uint16_t n1      = c1 ^ c0;
+    uint16_t n2      = c2 ^ (c1 & c0);
+    c0 = ~c0 & inc;
+    c1 = n1  & inc;
+    c2 = n2  & inc;
+    uint16_t integ = prevInputs ^ accept;
+
+    // 3-read majority; a middle read unlike both neighbours is a glitch
+    uint16_t h0 = filterHistory[0], h1 = filterHistory[1];
+    uint16_t vote = (h1 & h0) | (h1 & raw) | (h0 & raw);
+    glitch = (glitch & ~maj) | ((h0 ^ h1) & (h0 ^ raw) & maj);
+    filterHistory[1] = h0;
+    filterHistory[0] = raw;
+
+    for (int ch = 0; glitch; ch++, glitch >>= 1) {
+        if ((glitch & 1) && glitchCount[ch] < 0xFFFF) {
+            glitchCount[ch]++;
+            modbusTCP.holdingRegisterWrite(Reg::DIAG_GLITCH_BASE + ch, glitchCount[ch]);
         }
     }
+    return (integ & ~maj) | (vote & maj);
+}
 
-    prevInputs = raw;
+/** Load the filter limits from inputFilter into bit planes. */
+void applyInputFilter() {
+    filterLimit[0] = filterLimit[1] = filterLimit[2] = 0;
+    for (int ch = 0; ch < 16; ch++) {
+        if (inputFilter.scans[ch] < 1)                inputFilter.scans[ch] = 1;
+        if (inputFilter.scans[ch] > FILTER_MAX_SCANS) inputFilter.scans[ch] = FILTER_MAX_SCANS;
+        uint8_t limit = inputFilter.scans[ch] - 1;
+        for (int b = 0; b < 3; b++)
+            if (limit & (1u << b)) filterLimit[b] |= 1u << ch;
+    }
+    filterCount[0] = filterCount[1] = filterCount[2] = 0;
+}
 
-    // Mirror inputs into Modbus discrete-input registers for HMI
-    for (int i = 0; i < 16; i++) {
-        modbusTCP.discreteInputWrite(i, (raw >> i) & 1);
+/** Debounce one photo-eye sample: a change is accepted after
+ *  SENSOR_DEBOUNCE_SAMPLES equal samples, and a plant is counted on
+ *  the accepted rising edge (beam blocked). */
+void samplePhotoEye(uint16_t raw) {
+    bool level = raw & (1u << BIT_PHOTO_EYE);
+    if (level == sensorLevel) {
+        sensorDisagree = 0;
+        return;
     }
+    if (++sensorDisagree < SENSOR_DEBOUNCE_SAMPLES) return;
+    sensorLevel    = level;
+    sensorDisagree = 0;
+    if (!level) return;
+
+    sensorCount++;
+    if (currentState == STATE_RUN1 || currentState == STATE_RUN2) {
+        rateCounts++;
+        if (countSource == COUNT_SOURCE_SENSOR) countPlant();
+    }
+}
+
+/** Sample the photo-eye when its next SENSOR_SAMPLE_US slot is due.
+ *  Called from the scan slack, so pulses shorter than a scan are seen. */
+void serviceSensorSampler() {
+    if (currentState != STATE_RUN1 && currentState != STATE_RUN2) return;
+
+    uint32_t now = micros();
+    if ((int32_t)(now - nextSensorSampleUs) < 0) return;
+    nextSensorSampleUs += SENSOR_SAMPLE_US;
+    if ((int32_t)(now - nextSensorSampleUs) >= 0)
+        nextSensorSampleUs = now + SENSOR_SAMPLE_US;    // fell behind: re-anchor
+
+    samplePhotoEye(static_cast<uint16_t>(P1.readDiscrete(SLOT_DI)));
 }
 
 // =====================================================================
@@ -464,49 +1018,79 @@ void handleCountdownTimer() {
 
         if (remainingTime <= 0) {
             remainingTime = 0;
-            stateTimeDelayComplete();
+            dispatchEvent(EV_DELAY_DONE, SRC_TIMER);
         }
     }
 }
 
+/** Count plants at the configured interval without drift.  Elapsed
+ *  micros() accumulate and each count consumes exactly one interval,
+ *  so the remainder carries across ticks and a late scan catches up
+ *  (at most COUNTER_MAX_CATCHUP counts; any backlog is kept).  With the
+ *  photo-eye as count source only the journal flush runs here. */
 void handleCounterTimer() {
     if (currentState != STATE_RUN1 && currentState != STATE_RUN2) return;
 
-    if (millis() - lastCounterTick >= counterIntervalMs) {
-        lastCounterTick = millis();
+    uint32_t now = micros();
+    counterAccumUs += now - counterLastUs;
+    counterLastUs   = now;
+    if (countSource != COUNT_SOURCE_TIMER) counterAccumUs = 0;
 
-        currentCounter++;
-        totalCounter++;
-        countersSinceFlush++;
+    for (int n = 0; n < COUNTER_MAX_CATCHUP && counterAccumUs >= counterIntervalUs; n++) {
+        counterAccumUs -= counterIntervalUs;
+        countPlant();
+    }
 
-        if (countersSinceFlush >= COUNTER_BATCH_SIZE) {
-            saveCounter();
-            countersSinceFlush = 0;
+    if (countersSinceFlush >= COUNTER_BATCH_SIZE) {
+        saveCounter();
+        countersSinceFlush = 0;
+    }
+}
+
+/** One plant into the batch and lifetime counters.  The journal is
+ *  written by handleCounterTimer(), never from the slack sampler. */
+void countPlant() {
+    currentCounter++;
+    totalCounter++;
+    countersSinceFlush++;
+}
+
+/** Publish the counting block every RATE_UPDATE_MS: plant rate from
+ *  the photo-eye since the run / profile started, and the rate the
+ *  tray time factor predicts. */
+void handleCountRates() {
+    if (millis() - lastRateUpdateMs < RATE_UPDATE_MS) return;
+    lastRateUpdateMs = millis();
+
+    if (currentState == STATE_RUN1 || currentState == STATE_RUN2) {
+        uint32_t elapsedMs = millis() - rateStartMs;
+        if (elapsedMs > 0) {
+            uint64_t rate = (uint64_t)rateCounts * 600000u / elapsedMs;
+            rateMeasured  = rate > 0xFFFFu ? 0xFFFFu : (uint16_t)rate;
         }
     }
+    rateEstimated = saturateU16(600000000UL / counterIntervalUs);
+
+    modbusTCP.holdingRegisterWrite(Reg::RATE_MEASURED,  rateMeasured);
+    modbusTCP.holdingRegisterWrite(Reg::RATE_ESTIMATED, rateEstimated);
+    modbusTCP.holdingRegisterWrite(Reg::SENSOR_COUNT_L, (uint16_t)(sensorCount & 0xFFFF));
+    modbusTCP.holdingRegisterWrite(Reg::SENSOR_COUNT_H, (uint16_t)(sensorCount >> 16));
+    modbusTCP.holdingRegisterWrite(Reg::BATCH_START_L,  (uint16_t)(batchStartTime & 0xFFFF));
+    modbusTCP.holdingRegisterWrite(Reg::BATCH_START_H,  (uint16_t)(batchStartTime >> 16));
 }
 
 void handleBuzzerTimer() {
     if (currentState != STATE_BUZZER_DELAY) return;
 
-    unsigned long elapsed = (millis() - buzzerStartMs) / 1000;
+    uint32_t elapsed = (millis() - buzzerStartMs) / 1000;
 
-    if (elapsed >= (unsigned long)(BUZZER_PRE_SEC - 1) && buzzerSounding) {
+    if (elapsed >= (uint32_t)(BUZZER_PRE_SEC - 1) && buzzerSounding) {
         setBuzzer(false);
         buzzerSounding = false;
     }
 
-    if (elapsed >= (unsigned long)BUZZER_PRE_SEC) {
-        // Transition to the appropriate run state
-        if (previousState == STATE_STOP) {
-            stateRun1();
-        } else if (previousState == STATE_ESTOP) {
-            if (estopReturnState == STATE_RUN1)      stateRun1();
-            else if (estopReturnState == STATE_RUN2) stateRun2();
-            else                                     stateStop();
-        } else {
-            stateRun1();  // fallback
-        }
+    if (elapsed >= (uint32_t)BUZZER_PRE_SEC) {
+        dispatchEvent(EV_BUZZER_DONE, SRC_TIMER);
     }
 }
 
@@ -517,237 +1101,996 @@ void handleHeartbeat() {
     }
 }
 
+/** Advance the clock and publish it whenever the second changes. */
+void handleClock() {
+    tickClock();
+    if (clockSeconds == publishedClock) return;
+    publishedClock = clockSeconds;
+    modbusTCP.holdingRegisterWrite(Reg::CLOCK_NOW_L, (uint16_t)(clockSeconds & 0xFFFF));
+    modbusTCP.holdingRegisterWrite(Reg::CLOCK_NOW_H, (uint16_t)(clockSeconds >> 16));
+}
+
+/** Add the millis() elapsed since the last tick to the clock, plus the
+ *  drift correction: clockDriftPpb is owed per elapsed ms in clockTrim
+ *  and paid out a whole millisecond at a time.  Only uint32_t
+ *  differences of millis() are used, so the 49.7-day wrap is harmless. */
+void tickClock() {
+    uint32_t now   = millis();
+    uint32_t delta = now - clockLastMs;
+    clockLastMs    = now;
+    clockRawMs     = clockRawMs > 0xFFFFFFFFu - delta ? 0xFFFFFFFFu : clockRawMs + delta;
+
+    int64_t trim = clockTrim + (int64_t)delta * clockDriftPpb;
+    int32_t adj  = 0;
+    if (trim >= 1000000000 || trim <= -1000000000) {
+        adj   = (int32_t)(trim / 1000000000);
+        trim -= (int64_t)adj * 1000000000;
+    }
+    int32_t ms = (int32_t)clockMs + (int32_t)delta + adj;
+    if (ms < 0) {                       // slow clock, nothing elapsed: owe it
+        trim += (int64_t)adj * 1000000000;
+        ms   -= adj;
+    }
+    clockTrim = trim;
+    while (ms >= 1000) { ms -= 1000; clockSeconds++; }
+    clockMs = (uint16_t)ms;
+}
+
+/** Clock seconds, up to date within this scan. */
+uint32_t clockNow() {
+    tickClock();
+    return clockSeconds;
+}
+
+/** Apply Reg::CLOCK_SET.  The difference between the set time and the
+ *  kept time is the error accumulated since the last sync; over at
+ *  least CLOCK_DRIFT_MIN_MS it is turned into a drift estimate (taken
+ *  whole the first time, then half of each new residual, so Modbus
+ *  latency in one sync does not swing it).  Errors beyond
+ *  CLOCK_MAX_DRIFT_PPM are a step of the PC's clock, not drift.  A set
+ *  time below CLOCK_EPOCH_MIN is refused, so any timestamp under it is
+ *  always seconds since boot and never a wall-clock time. */
+void syncClock() {
+    uint32_t setSec = (uint32_t)modbusTCP.holdingRegisterRead(Reg::CLOCK_SET_L) |
+                      ((uint32_t)modbusTCP.holdingRegisterRead(Reg::CLOCK_SET_H) << 16);
+    uint16_t setMs  = (uint16_t)modbusTCP.holdingRegisterRead(Reg::CLOCK_SET_MS);
+    if (setMs > 999) setMs = 999;
+    if (setSec < CLOCK_EPOCH_MIN) {
+        Serial.print(F("Clock set refused, not epoch seconds: ")); Serial.println(setSec);
+        return;
+    }
+
+    tickClock();
+    int64_t offsetMs = ((int64_t)setSec - clockSeconds) * 1000 + setMs - clockMs;
+
+    // Steps beyond the drift window are rejected before scaling: offsetMs
+    // × 10^9 overflows past ~106 days (a PC or HMI with a reset RTC)
+    const int32_t maxPpb  = (int32_t)CLOCK_MAX_DRIFT_PPM * 1000;
+    const int64_t driftMs = (int64_t)clockRawMs * CLOCK_MAX_DRIFT_PPM / 1000000;
+    if (clockStatus != CLOCK_UNSET && clockRawMs >= CLOCK_DRIFT_MIN_MS &&
+        offsetMs >= -driftMs && offsetMs <= driftMs) {
+        int64_t errPpb = offsetMs * 1000000000 / clockRawMs;
+        if (errPpb >= -maxPpb && errPpb <= maxPpb) {
+            int32_t ppb = clockDriftPpb + (int32_t)(clockStatus == CLOCK_TRIMMED ? errPpb / 2 : errPpb);
+            if (ppb >  maxPpb) ppb =  maxPpb;
+            if (ppb < -maxPpb) ppb = -maxPpb;
+            clockDriftPpb = ppb;
+            clockStatus   = CLOCK_TRIMMED;
+        }
+    }
+    if (clockStatus == CLOCK_UNSET) {
+        // The batch started before the first sync: move it onto the new time base
+        batchStartTime += setSec - clockSeconds;
+        clockStatus = CLOCK_SYNCED;
+    }
+
+    clockSeconds = setSec;
+    clockMs      = setMs;
+    clockRawMs   = 0;
+    clockTrim    = 0;
+
+    int16_t offset = offsetMs > 32767 ? 32767 : offsetMs < -32768 ? -32768 : (int16_t)offsetMs;
+    modbusTCP.holdingRegisterWrite(Reg::CLOCK_STATUS,    clockStatus);
+    modbusTCP.holdingRegisterWrite(Reg::CLOCK_DRIFT,     (uint16_t)(int16_t)(clockDriftPpb / 100));
+    modbusTCP.holdingRegisterWrite(Reg::CLOCK_OFFSET_MS, (uint16_t)offset);
+    handleClock();
+
+    Serial.print(F("Clock set: ")); Serial.print((long)offset);
+    Serial.print(F(" ms off, drift ")); Serial.print((long)clockDriftPpb);
+    Serial.println(F(" ppb"));
+}
+
 // =====================================================================
 //  MODBUS TCP SERVER  (for CM5-T15W HMI)
 // =====================================================================
 
 void handleModbus() {
-    // Accept new HMI connection (one client at a time)
-    EthernetClient newClient = ethServer.available();
-    if (newClient) {
-        if (modbusClient && modbusClient.connected()) {
-            newClient.stop();   // already have a client
+    expireModbusClients();              // free dead sockets before reuse
+    acceptModbusClients();
+
+    // New scan: every client gets a fresh request quota
+    for (int i = 0; i < MODBUS_MAX_CLIENTS; i++) sessions[i].scanRequests = 0;
+
+    // One round-robin pass; the deadline scheduler serves the rest in slack
+    pollModbusSessions();
+}
+
+/** Take new connections into free session slots; refuse when full. */
+void acceptModbusClients() {
+    EthernetClient newClient = ethServer.accept();
+    while (newClient) {
+        newClient.setConnectionTimeout(MODBUS_CLOSE_TIMEOUT_MS);   // bounds stop()
+        int slot = -1;
+        for (int i = 0; i < MODBUS_MAX_CLIENTS; i++) {
+            if (!sessions[i].active) { slot = i; break; }
+        }
+
+        if (slot < 0) {
+            newClient.stop();
+            sessionsRejected++;
+            Serial.println(F("Modbus client refused: all sessions busy"));
         } else {
-            modbusClient = newClient;
-            modbusTCP.accept(modbusClient);
-            Serial.println(F("HMI connected"));
+            ModbusSession& s = sessions[slot];
+            s.client        = newClient;
+            s.active        = true;
+            s.lastRequestMs = millis();
+            s.requests      = 0;
+            s.scanRequests  = 0;
+            Serial.print(F("Modbus client connected, slot ")); Serial.println(slot);
         }
+        newClient = ethServer.accept();
     }
+}
 
-    // Poll for Modbus requests (non-blocking)
-    if (modbusClient && modbusClient.connected()) {
-        modbusTCP.poll();
+/** Free slots whose client disconnected or went quiet. */
+void expireModbusClients() {
+    for (int i = 0; i < MODBUS_MAX_CLIENTS; i++) {
+        ModbusSession& s = sessions[i];
+        if (!s.active) continue;
+
+        if (!s.client.connected()) {
+            s.client.stop();
+            s.active = false;
+            Serial.print(F("Modbus client disconnected, slot ")); Serial.println(i);
+        } else if (millis() - s.lastRequestMs >= MODBUS_IDLE_TIMEOUT_MS) {
+            s.client.stop();
+            s.active = false;
+            sessionsTimedOut++;
+            Serial.print(F("Modbus client idle timeout, slot ")); Serial.println(i);
+        }
     }
 }
 
+/** One round-robin pass over the sessions, serving at most one request
+ *  from each client that still has quota this scan.  The pass starts
+ *  after the client served first last time, so no slot is favoured.
+ *  Returns the number of requests served. */
+int pollModbusSessions() {
+    int served = 0;
+    for (int n = 0; n < MODBUS_MAX_CLIENTS; n++) {
+        ModbusSession& s = sessions[nextSession];
+        nextSession = (nextSession + 1) % MODBUS_MAX_CLIENTS;
+        if (!s.active || s.scanRequests >= MODBUS_REQS_PER_SCAN) continue;
+
+        modbusTCP.accept(s.client);     // point the server at this socket
+        if (modbusTCP.poll() > 0) {
+            s.requests++;
+            s.scanRequests++;
+            s.lastRequestMs = millis();
+            served++;
+        }
+    }
+    return served;
+}
+
 void processHMICommands() {
+    flashCmdRun = false;
+
     // ── One-shot command register ───────────────────────────────────
     int cmd = (int)modbusTCP.holdingRegisterRead(Reg::COMMAND);
     if (cmd != Cmd::NONE) {
         modbusTCP.holdingRegisterWrite(Reg::COMMAND, 0);  // clear immediately
+        if (cmd <= Cmd::RESET_CURRENT) runCommand(cmd, 0);
+    }
 
-        switch (cmd) {
-        case Cmd::START:
-            if (currentState == STATE_STOP && speedSelected >= 1 && traySelected >= 1)
-                stateBuzzerDelay();
-            break;
-
-        case Cmd::STOP:
-            if (currentState != STATE_ESTOP)
-                stateStop();
-            break;
-
-        case Cmd::START_DELAY:
-            if (currentState == STATE_RUN1 || currentState == STATE_RUN2)
-                stateTimeDelay();
-            break;
-
-        case Cmd::ESTOP:
-            stateEstop();
-            break;
-
-        case Cmd::ESTOP_CLEAR:
-            if (currentState == STATE_ESTOP)
-                stateEstopCleared();
-            break;
-
-        case Cmd::RESET_CURRENT:
-            logProductionRun();
-            currentCounter = 0;
-            break;
-        }
+    serviceMailbox();
+    serviceProductionLog();
+
+    // ── Clock sync (one-shot) ───────────────────────────────────────
+    if (modbusTCP.holdingRegisterRead(Reg::CLOCK_SYNC) == 1) {
+        modbusTCP.holdingRegisterWrite(Reg::CLOCK_SYNC, 0);
+        syncClock();
     }
 
-    // ── Persistent speed selection ──────────────────────────────────
+    // ── Persistent selections (acted on when the HMI changes them) ──
     int sp = (int)modbusTCP.holdingRegisterRead(Reg::SPEED_SELECT);
-    if (sp != prevHMISpeed && sp >= 1 && sp <= NUM_SPEEDS) {
-        prevHMISpeed  = sp;
-        speedSelected = sp;
-        Serial.print(F("Speed → ")); Serial.println(sp);
-        if (traySelected >= 1) setMotorSpeeds();
-    }
+    if (sp != prevHMISpeed && sp >= 1 && sp <= NUM_SPEEDS) runCommand(Cmd::SELECT_SPEED, sp);
 
-    // ── Persistent tray selection ───────────────────────────────────
     int tr = (int)modbusTCP.holdingRegisterRead(Reg::TRAY_SELECT);
-    if (tr != prevHMITray && tr >= 1 && tr <= NUM_TRAYS) {
-        prevHMITray  = tr;
-        traySelected = tr;
-        Serial.print(F("Tray → ")); Serial.println(TRAY_NAMES[tr - 1]);
-        if (speedSelected >= 1) setMotorSpeeds();
-    }
+    if (tr != prevHMITray && tr >= 1 && tr <= NUM_TRAYS) runCommand(Cmd::SELECT_TRAY, tr);
+
+    int src = (int)modbusTCP.holdingRegisterRead(Reg::COUNT_SOURCE);
+    if (src != countSource && (src == COUNT_SOURCE_TIMER || src == COUNT_SOURCE_SENSOR))
+        runCommand(Cmd::COUNT_SOURCE, src);
 
-    // ── One-shot timer adjustment ───────────────────────────────────
-    int adj = (int)(int16_t)modbusTCP.holdingRegisterRead(Reg::TIMER_ADJUST);
+    // ── One-shot registers ──────────────────────────────────────────
+    int16_t adj = (int16_t)modbusTCP.holdingRegisterRead(Reg::TIMER_ADJUST);
     if (adj != 0) {
         modbusTCP.holdingRegisterWrite(Reg::TIMER_ADJUST, 0);
-        waitTime += adj;
+        runCommand(Cmd::TIMER_ADJUST, adj);
+    }
+
+    if (modbusTCP.holdingRegisterRead(Reg::SAVE_TIMER) == 1 && !flashCommandWaits(Cmd::SAVE_TIMER)) {
+        modbusTCP.holdingRegisterWrite(Reg::SAVE_TIMER, 0);
+        runCommand(Cmd::SAVE_TIMER, 0);
+    }
+
+    if (modbusTCP.holdingRegisterRead(Reg::RESET_TOTAL) == 1 && !flashCommandWaits(Cmd::RESET_TOTAL)) {
+        modbusTCP.holdingRegisterWrite(Reg::RESET_TOTAL, 0);
+        runCommand(Cmd::RESET_TOTAL, 0);
+    }
+
+    if (modbusTCP.holdingRegisterRead(Reg::SAVE_CALIB) == 1 && !flashCommandWaits(Cmd::SAVE_CALIB)) {
+        modbusTCP.holdingRegisterWrite(Reg::SAVE_CALIB, 0);
+        runCommand(Cmd::SAVE_CALIB, 0);
+    }
+
+    if (modbusTCP.holdingRegisterRead(Reg::AUTO_CALIB) == 1 && !flashCommandWaits(Cmd::AUTO_CALIB)) {
+        modbusTCP.holdingRegisterWrite(Reg::AUTO_CALIB, 0);
+        runCommand(Cmd::AUTO_CALIB, 0);
+    }
+}
+
+/** Run one command, from the one-shot registers or the mailbox.
+ *  Selections are written back to their persistent registers so the
+ *  HMI shows them and the register edge detection stays in step. */
+CmdResult runCommand(int op, int16_t arg) {
+    if (commandWritesFlash(op)) flashCmdRun = true;
+
+    switch (op) {
+    case Cmd::NONE:        return CMD_OK;
+    case Cmd::START:       return dispatchEvent(EV_START,       SRC_HMI) ? CMD_OK : CMD_REFUSED;
+    case Cmd::STOP:        return dispatchEvent(EV_STOP,        SRC_HMI) ? CMD_OK : CMD_REFUSED;
+    case Cmd::START_DELAY: return dispatchEvent(EV_START_DELAY, SRC_HMI) ? CMD_OK : CMD_REFUSED;
+    case Cmd::ESTOP:       return dispatchEvent(EV_ESTOP,       SRC_HMI) ? CMD_OK : CMD_REFUSED;
+    case Cmd::ESTOP_CLEAR: return dispatchEvent(EV_ESTOP_CLEAR, SRC_HMI) ? CMD_OK : CMD_REFUSED;
+
+    case Cmd::RESET_CURRENT:
+        logProductionRun(STOP_REASON_HMI_RESET);
+        currentCounter = 0;
+        batchStartTime = clockNow();
+        if (currentState == STATE_RUN1 || currentState == STATE_RUN2 ||
+            currentState == STATE_TIME_DELAY) {
+            runOpen = true; runStartMs = millis();
+        }
+        return CMD_OK;
+
+    case Cmd::TIMER_ADJUST:
+        waitTime += arg;
         if (waitTime < 0) waitTime = 0;
         remainingTime = waitTime;
-        Serial.print(F("Timer adjust ")); Serial.print(adj);
+        Serial.print(F("Timer adjust ")); Serial.print(arg);
         Serial.print(F(" → ")); Serial.println(waitTime);
-    }
+        return CMD_OK;
 
-    // ── Save timer ──────────────────────────────────────────────────
-    if (modbusTCP.holdingRegisterRead(Reg::SAVE_TIMER) == 1) {
-        modbusTCP.holdingRegisterWrite(Reg::SAVE_TIMER, 0);
+    case Cmd::SAVE_TIMER:
         calib.waitTime = waitTime;
-        saveCalibration();
+        saveCalibSection(CALSEC_TIMER);
         Serial.print(F("Timer saved: ")); Serial.println(waitTime);
-    }
+        return CMD_OK;
 
-    // ── Reset total counter ─────────────────────────────────────────
-    if (modbusTCP.holdingRegisterRead(Reg::RESET_TOTAL) == 1) {
-        modbusTCP.holdingRegisterWrite(Reg::RESET_TOTAL, 0);
+    case Cmd::RESET_TOTAL:
         Serial.print(F("Total counter reset (was "));
         Serial.print(totalCounter); Serial.println(F(")"));
         totalCounter = 0;
         saveCounter();
-    }
+        return CMD_OK;
 
-    // ── Save calibration ────────────────────────────────────────────
-    if (modbusTCP.holdingRegisterRead(Reg::SAVE_CALIB) == 1) {
-        modbusTCP.holdingRegisterWrite(Reg::SAVE_CALIB, 0);
+    case Cmd::SAVE_CALIB:
         pullCalibrationFromRegisters();
+        pullInputFilterFromRegisters();
+        pullRampsFromRegisters();
+        pullStartSequenceFromRegisters();
         saveCalibration();
         Serial.println(F("Calibration saved"));
+        return CMD_OK;
+
+    case Cmd::SELECT_SPEED:
+        if (arg < 1 || arg > NUM_SPEEDS) return CMD_BAD_ARG;
+        prevHMISpeed  = arg;
+        speedSelected = arg;
+        modbusTCP.holdingRegisterWrite(Reg::SPEED_SELECT, arg);
+        Serial.print(F("Speed → ")); Serial.println(arg);
+        if (traySelected >= 1) setMotorSpeeds();
+        return CMD_OK;
+
+    case Cmd::SELECT_TRAY:
+        if (arg < 1 || arg > NUM_TRAYS) return CMD_BAD_ARG;
+        prevHMITray  = arg;
+        traySelected = arg;
+        modbusTCP.holdingRegisterWrite(Reg::TRAY_SELECT, arg);
+        Serial.print(F("Tray → ")); Serial.println(TRAY_NAMES[arg - 1]);
+        if (speedSelected >= 1) setMotorSpeeds();
+        return CMD_OK;
+
+    case Cmd::COUNT_SOURCE:
+        if (arg != COUNT_SOURCE_TIMER && arg != COUNT_SOURCE_SENSOR) return CMD_BAD_ARG;
+        countSource = static_cast<CountSource>(arg);
+        modbusTCP.holdingRegisterWrite(Reg::COUNT_SOURCE, arg);
+        Serial.print(F("Count source → "));
+        Serial.println(countSource == COUNT_SOURCE_SENSOR ? F("photo-eye") : F("timer"));
+        return CMD_OK;
+
+    case Cmd::AUTO_CALIB:
+        return autoCalibrateTrayTime() ? CMD_OK : CMD_REFUSED;
     }
+    return CMD_BAD_OPCODE;
 }
 
+/** Commands that erase and program flash (calibration store, counter
+ *  journal).  STOP and E-STOP may also save the counter but never wait. */
+bool commandWritesFlash(int op) {
+    return op == Cmd::SAVE_TIMER || op == Cmd::RESET_TOTAL ||
+           op == Cmd::SAVE_CALIB || op == Cmd::AUTO_CALIB;
+}
+
+/** True if `op` writes flash and another such command already ran this
+ *  scan.  Each is a blocking row erase + write, so back to back they
+ *  would stack into one overrun; like the journal commits
+ *  (JOURNAL_COMMIT_US), the rest wait for the next scan. */
+bool flashCommandWaits(int op) {
+    return flashCmdRun && commandWritesFlash(op);
+}
+
+/** Run every queued mailbox command in sequence order.  The next
+ *  command is the one in slot (MBX_LAST_SEQ + 1) % MAILBOX_DEPTH
+ *  carrying that sequence; anything else in the slot is an old entry
+ *  and waits.  Each result is written back into its slot.  A second
+ *  flash-writing command stops the pass; it and everything after it
+ *  run from the next scan. */
+void serviceMailbox() {
+    uint16_t first = mbxLastSeq;
+    for (int n = 0; n < MAILBOX_DEPTH; n++) {
+        uint16_t next = mbxLastSeq == 0xFFFF ? 1 : mbxLastSeq + 1;
+        int      base = Reg::MAILBOX_BASE + (next % MAILBOX_DEPTH) * Reg::MAILBOX_WORDS;
+        if ((uint16_t)modbusTCP.holdingRegisterRead(base) != next) break;
+
+        int       op  = (int)modbusTCP.holdingRegisterRead(base + 1);
+        int16_t   arg = (int16_t)modbusTCP.holdingRegisterRead(base + 2);
+        if (flashCommandWaits(op)) break;
+        CmdResult res = runCommand(op, arg);
+        modbusTCP.holdingRegisterWrite(base + 3, res);
+        modbusTCP.holdingRegisterWrite(Reg::MBX_LAST_RESULT, res);
+        mbxLastSeq = next;
+    }
+    if (mbxLastSeq != first) modbusTCP.holdingRegisterWrite(Reg::MBX_LAST_SEQ, mbxLastSeq);
+}
+
+/** Publish the status block (0-11) and the discrete-input mirror,
+ *  writing only words / bits that changed since the last publish.
+ *  Any change bumps Reg::STATUS_SEQ, so a client can poll that one word
+ *  and re-read the block only when it moves.  Every STATUS_REFRESH_MS
+ *  everything is rewritten in case a client overwrote a status word. */
 void updateStatusRegisters() {
-    modbusTCP.holdingRegisterWrite(Reg::STATE,          currentState);
-    modbusTCP.holdingRegisterWrite(Reg::SPEED_SELECTED, speedSelected);
-    modbusTCP.holdingRegisterWrite(Reg::REMAINING_TIME, remainingTime >= 0 ? remainingTime : 0);
-    modbusTCP.holdingRegisterWrite(Reg::WAIT_TIME,      waitTime);
-    modbusTCP.holdingRegisterWrite(Reg::CURRENT_CTR_L,  (uint16_t)(currentCounter & 0xFFFF));
-    modbusTCP.holdingRegisterWrite(Reg::CURRENT_CTR_H,  (uint16_t)(currentCounter >> 16));
-    modbusTCP.holdingRegisterWrite(Reg::TOTAL_CTR_L,    (uint16_t)(totalCounter & 0xFFFF));
-    modbusTCP.holdingRegisterWrite(Reg::TOTAL_CTR_H,    (uint16_t)(totalCounter >> 16));
-    modbusTCP.holdingRegisterWrite(Reg::SELECTED_TRAY,  traySelected);
-    modbusTCP.holdingRegisterWrite(Reg::HEARTBEAT,      heartbeatToggle ? 1 : 0);
-    modbusTCP.holdingRegisterWrite(Reg::INPUT_STATE,    prevInputs);
-    modbusTCP.holdingRegisterWrite(Reg::OUTPUT_STATE,   outputState);
+    uint16_t status[Reg::STATUS_COUNT];
+    status[Reg::STATE]          = currentState;
+    status[Reg::SPEED_SELECTED] = speedSelected;
+    status[Reg::REMAINING_TIME] = remainingTime >= 0 ? remainingTime : 0;
+    status[Reg::WAIT_TIME]      = waitTime;
+    status[Reg::CURRENT_CTR_L]  = (uint16_t)(currentCounter & 0xFFFF);
+    status[Reg::CURRENT_CTR_H]  = (uint16_t)(currentCounter >> 16);
+    status[Reg::TOTAL_CTR_L]    = (uint16_t)(totalCounter & 0xFFFF);
+    status[Reg::TOTAL_CTR_H]    = (uint16_t)(totalCounter >> 16);
+    status[Reg::SELECTED_TRAY]  = traySelected;
+    status[Reg::HEARTBEAT]      = heartbeatToggle ? 1 : 0;
+    status[Reg::INPUT_STATE]    = prevInputs;
+    status[Reg::OUTPUT_STATE]   = appliedRelays;
+
+    bool refresh = !statusShadowValid ||
+                   (STATUS_REFRESH_MS > 0 && millis() - lastStatusRefreshMs >= STATUS_REFRESH_MS);
+    if (refresh) {
+        statusShadowValid   = true;
+        lastStatusRefreshMs = millis();
+    }
+    bool changed = false;
+
+    for (int r = 0; r < Reg::STATUS_COUNT; r++) {
+        if (status[r] != publishedStatus[r]) changed = true;
+        else if (!refresh)                   continue;
+        modbusTCP.holdingRegisterWrite(r, status[r]);
+        publishedStatus[r] = status[r];
+    }
+
+    for (int i = 0; i < NUM_MOTORS; i++) {
+        if (motorRamp[i] != publishedRamp[i]) changed = true;
+        else if (!refresh)                     continue;
+        modbusTCP.holdingRegisterWrite(Reg::RAMP_POS_BASE + i, motorRamp[i]);
+        publishedRamp[i] = motorRamp[i];
+    }
+
+    if (startStep != publishedStartStep || refresh) {
+        if (startStep != publishedStartStep) changed = true;
+        modbusTCP.holdingRegisterWrite(Reg::START_SEQ_STEP, startStep);
+        publishedStartStep = startStep;
+    }
+
+    // Discrete inputs: XOR finds the bits that moved
+    uint16_t diff = refresh ? 0xFFFF : (uint16_t)(prevInputs ^ publishedInputs);
+    if (prevInputs != publishedInputs) changed = true;
+    for (int i = 0; diff; i++, diff >>= 1) {
+        if (diff & 1) modbusTCP.discreteInputWrite(i, (prevInputs >> i) & 1);
+    }
+    publishedInputs = prevInputs;
+
+    if (changed) statusSeq++;
+    if (changed || refresh) modbusTCP.holdingRegisterWrite(Reg::STATUS_SEQ, statusSeq);
+}
+
+// =====================================================================
+//  SCAN DIAGNOSTICS
+// =====================================================================
+
+uint16_t saturateU16(unsigned long v) {
+    return v > 0xFFFFu ? 0xFFFFu : static_cast<uint16_t>(v);
+}
+
+/** Close the stage that just ran: store its duration and restart
+ *  the stage clock. */
+void markStage(ScanStage stage) {
+    uint32_t now = micros();
+    stageUs[stage] = saturateU16(now - stageMarkUs);
+    stageMarkUs    = now;
+    SCAN_PROBE(STAGE_NAMES[stage]);
+}
+
+/** Fold this scan's work time into last / max / rolling average,
+ *  count overruns, and publish the diagnostics block. */
+void finishScanDiagnostics() {
+    uint32_t workUs = stageMarkUs - scanStartUs;
+
+    scanLastUs = saturateU16(workUs);
+    if (scanLastUs > scanMaxUs) scanMaxUs = scanLastUs;
+    scanAvgAccum += scanLastUs - (scanAvgAccum >> SCAN_AVG_SHIFT);
+    if (workUs > SCAN_CYCLE_MS * 1000UL) scanOverruns++;
+
+    if (modbusTCP.holdingRegisterRead(Reg::DIAG_RESET) == 1) {
+        modbusTCP.holdingRegisterWrite(Reg::DIAG_RESET, 0);
+        scanMaxUs            = 0;
+        scanOverruns         = 0;
+        backplaneWrites      = 0;
+        backplaneWritesSaved = 0;
+        for (int ch = 0; ch < 16; ch++) {
+            glitchCount[ch] = 0;
+            modbusTCP.holdingRegisterWrite(Reg::DIAG_GLITCH_BASE + ch, 0);
+        }
+    }
+
+    for (int i = 0; i < NUM_STAGES; i++)
+        modbusTCP.holdingRegisterWrite(Reg::DIAG_MODBUS_US + i, stageUs[i]);
+    modbusTCP.holdingRegisterWrite(Reg::DIAG_SCAN_LAST_US, scanLastUs);
+    modbusTCP.holdingRegisterWrite(Reg::DIAG_SCAN_MAX_US,  scanMaxUs);
+    modbusTCP.holdingRegisterWrite(Reg::DIAG_SCAN_AVG_US,
+                                   (uint16_t)(scanAvgAccum >> SCAN_AVG_SHIFT));
+    modbusTCP.holdingRegisterWrite(Reg::DIAG_OVERRUNS_L, (uint16_t)(scanOverruns & 0xFFFF));
+    modbusTCP.holdingRegisterWrite(Reg::DIAG_OVERRUNS_H, (uint16_t)(scanOverruns >> 16));
+    modbusTCP.holdingRegisterWrite(Reg::DIAG_BP_WRITES_L, (uint16_t)(backplaneWrites & 0xFFFF));
+    modbusTCP.holdingRegisterWrite(Reg::DIAG_BP_WRITES_H, (uint16_t)(backplaneWrites >> 16));
+    modbusTCP.holdingRegisterWrite(Reg::DIAG_BP_SAVED_L,  (uint16_t)(backplaneWritesSaved & 0xFFFF));
+    modbusTCP.holdingRegisterWrite(Reg::DIAG_BP_SAVED_H,  (uint16_t)(backplaneWritesSaved >> 16));
+
+    uint16_t activeClients = 0;
+    for (int i = 0; i < MODBUS_MAX_CLIENTS; i++) {
+        if (sessions[i].active) activeClients++;
+        modbusTCP.holdingRegisterWrite(Reg::DIAG_CLIENT_REQS_BASE + i * 2,
+                                       (uint16_t)(sessions[i].requests & 0xFFFF));
+        modbusTCP.holdingRegisterWrite(Reg::DIAG_CLIENT_REQS_BASE + i * 2 + 1,
+                                       (uint16_t)(sessions[i].requests >> 16));
+    }
+    modbusTCP.holdingRegisterWrite(Reg::DIAG_CLIENTS_ACTIVE, activeClients);
+    modbusTCP.holdingRegisterWrite(Reg::DIAG_CLIENTS_REJECT, sessionsRejected);
+    modbusTCP.holdingRegisterWrite(Reg::DIAG_CLIENTS_IDLE,   sessionsTimedOut);
 }
 
 // =====================================================================
 //  CALIBRATION ↔ MODBUS REGISTERS
 // =====================================================================
 
-/** Push current CalibrationData into Modbus holding registers
- *  so the HMI can display / edit them.  Factor × 1000 → uint16. */
-void pushCalibrationToRegisters() {
-    for (int m = 0; m < NUM_MOTORS; m++)
-        for (int s = 0; s < NUM_SPEEDS; s++)
-            modbusTCP.holdingRegisterWrite(
-                Reg::MOTOR_FACTORS_BASE + m * NUM_SPEEDS + s,
-                (uint16_t)(calib.motorFactors[m][s] * 1000.0f));
+/** Register address and RAM factor behind calibration slot i, counted
+ *  0..Reg::CALIB_COUNT-1 across the motor, tray-time and tray-M8 tables. */
+float& calibSlot(int i, int& reg) {
+    if (i < Reg::MOTOR_FACTORS_COUNT) {
+        reg = Reg::MOTOR_FACTORS_BASE + i;
+        return calib.motorFactors[i / NUM_SPEEDS][i % NUM_SPEEDS];
+    }
+    i -= Reg::MOTOR_FACTORS_COUNT;
+    if (i < Reg::TRAY_FACTORS_COUNT) {
+        reg = Reg::TRAY_TIME_BASE + i;
+        return calib.trayTimeFactors[i / NUM_SPEEDS][i % NUM_SPEEDS];
+    }
+    i -= Reg::TRAY_FACTORS_COUNT;
+    reg = Reg::TRAY_M8_BASE + i;
+    return calib.trayMotor8Factors[i / NUM_SPEEDS][i % NUM_SPEEDS];
+}
 
-    for (int t = 0; t < NUM_TRAYS; t++)
-        for (int s = 0; s < NUM_SPEEDS; s++)
-            modbusTCP.holdingRegisterWrite(
-                Reg::TRAY_TIME_BASE + t * NUM_SPEEDS + s,
-                (uint16_t)(calib.trayTimeFactors[t][s] * 1000.0f));
+/** Flag the profiles that calibration slot i feeds for a rebuild. */
+void markProfilesDirty(int i) {
+    if (i < Reg::MOTOR_FACTORS_COUNT) {
+        profileDirty[i % NUM_SPEEDS] = (1u << NUM_TRAYS) - 1;   // every tray
+        return;
+    }
+    i = (i - Reg::MOTOR_FACTORS_COUNT) % Reg::TRAY_FACTORS_COUNT;
+    profileDirty[i % NUM_SPEEDS] |= 1u << (i / NUM_SPEEDS);
+}
 
-    for (int t = 0; t < NUM_TRAYS; t++)
-        for (int s = 0; s < NUM_SPEEDS; s++)
-            modbusTCP.holdingRegisterWrite(
-                Reg::TRAY_M8_BASE + t * NUM_SPEEDS + s,
-                (uint16_t)(calib.trayMotor8Factors[t][s] * 1000.0f));
+/** Range check for a register value (factor ×1000) in slot i. */
+bool calibValueValid(int i, long value) {
+    bool trayTime = i >= Reg::MOTOR_FACTORS_COUNT &&
+                    i <  Reg::MOTOR_FACTORS_COUNT + Reg::TRAY_FACTORS_COUNT;
+    if (trayTime) return value >= CALIB_TRAY_TIME_MIN && value <= CALIB_TRAY_TIME_MAX;
+    return value >= 0 && value <= CALIB_SPEED_FACTOR_MAX;
+}
+
+/** Push current CalibrationData into Modbus holding registers
+ *  so the HMI can display / edit them.  Factor × 1000 → uint16.
+ *  Only registers that differ from calibRegs are written. */
+void pushCalibrationToRegisters() {
+    for (int i = 0; i < Reg::CALIB_COUNT; i++) {
+        int      reg;
+        uint16_t value = (uint16_t)(calibSlot(i, reg) * 1000.0f);
+        SOFT_FLOAT_OPS(2);
+        if (calibRegsValid && value == calibRegs[i]) continue;
+        modbusTCP.holdingRegisterWrite(reg, value);
+        calibRegs[i] = value;
+    }
+    calibRegsValid = true;
 }
 
 /** Pull edited calibration values from Modbus registers back into
- *  CalibrationData struct.  uint16 / 1000.0 → factor. */
+ *  CalibrationData struct.  The block is diffed against calibRegs, so
+ *  only words the HMI changed are range-checked and converted
+ *  (uint16 / 1000.0 → factor); an out-of-range value is refused and
+ *  its register restored.  Only the motor profiles an edit touched
+ *  are rebuilt, and reloaded only if one is the selected speed / tray. */
 void pullCalibrationFromRegisters() {
-    for (int m = 0; m < NUM_MOTORS; m++)
-        for (int s = 0; s < NUM_SPEEDS; s++)
-            calib.motorFactors[m][s] =
-                modbusTCP.holdingRegisterRead(
-                    Reg::MOTOR_FACTORS_BASE + m * NUM_SPEEDS + s) / 1000.0f;
+    int  applied   = 0;
+    int  refused   = 0;
+
+    for (int i = 0; i < Reg::CALIB_COUNT; i++) {
+        int    reg;
+        float& factor = calibSlot(i, reg);
+        long   value  = modbusTCP.holdingRegisterRead(reg);
+        if (value == calibRegs[i]) continue;
+
+        if (!calibValueValid(i, value)) {
+            modbusTCP.holdingRegisterWrite(reg, calibRegs[i]);
+            refused++;
+            continue;
+        }
+        factor       = value / 1000.0f;
+        SOFT_FLOAT_OPS(2);
+        calibRegs[i] = (uint16_t)value;
+        applied++;
+        markProfilesDirty(i);
+    }
+
+    Serial.print(F("Calibration edits: ")); Serial.print(applied);
+    Serial.print(F(" applied, ")); Serial.print(refused);
+    Serial.println(F(" refused (out of range)"));
+
+    // Rebuild what the edits touched; reload only if that includes
+    // the selected speed / tray
+    bool active = speedSelected >= 1 && traySelected >= 1 &&
+                  (profileDirty[speedSelected - 1] & (1u << (traySelected - 1)));
+    buildProfiles();
+    if (active) setMotorSpeeds();
+}
+
+/** Publish the input filter: time in ms per channel (a whole number
+ *  of scans) and the majority mask. */
+void pushInputFilterToRegisters() {
+    for (int ch = 0; ch < 16; ch++)
+        modbusTCP.holdingRegisterWrite(Reg::FILTER_MS_BASE + ch,
+                                       (uint16_t)(inputFilter.scans[ch] * SCAN_CYCLE_MS));
+    modbusTCP.holdingRegisterWrite(Reg::FILTER_MAJORITY, inputFilter.majorityMask);
+}
+
+/** Apply edited filter registers.  A time is rounded up to whole
+ *  scans and written back as applied; more than FILTER_MAX_SCANS scans
+ *  is refused and the register restored. */
+void pullInputFilterFromRegisters() {
+    for (int ch = 0; ch < 16; ch++) {
+        long ms = modbusTCP.holdingRegisterRead(Reg::FILTER_MS_BASE + ch);
+        if (ms == (long)(inputFilter.scans[ch] * SCAN_CYCLE_MS)) continue;
+
+        long scans = (ms + (long)SCAN_CYCLE_MS - 1) / (long)SCAN_CYCLE_MS;
+        if (scans < 1) scans = 1;
+        if (ms < 0 || scans > FILTER_MAX_SCANS) {
+            Serial.print(F("Input filter ch ")); Serial.print(ch + 1);
+            Serial.println(F(" refused (out of range)"));
+        } else {
+            inputFilter.scans[ch] = (uint8_t)scans;
+        }
+        modbusTCP.holdingRegisterWrite(Reg::FILTER_MS_BASE + ch,
+                                       (uint16_t)(inputFilter.scans[ch] * SCAN_CYCLE_MS));
+    }
+    inputFilter.majorityMask = (uint16_t)modbusTCP.holdingRegisterRead(Reg::FILTER_MAJORITY);
+    applyInputFilter();
+}
+
+/** Publish the accel / decel ramp times of every motor. */
+void pushRampsToRegisters() {
+    for (int i = 0; i < NUM_MOTORS; i++) {
+        modbusTCP.holdingRegisterWrite(Reg::RAMP_ACCEL_BASE + i, ramps.accelMs[i]);
+        modbusTCP.holdingRegisterWrite(Reg::RAMP_DECEL_BASE + i, ramps.decelMs[i]);
+    }
+}
+
+/** Apply edited ramp times; above RAMP_MAX_MS is refused and the
+ *  register restored. */
+void pullRampsFromRegisters() {
+    for (int i = 0; i < 2 * NUM_MOTORS; i++) {
+        bool      decel = i >= NUM_MOTORS;
+        int       m     = decel ? i - NUM_MOTORS : i;
+        int       reg   = (decel ? Reg::RAMP_DECEL_BASE : Reg::RAMP_ACCEL_BASE) + m;
+        uint16_t& ms    = decel ? ramps.decelMs[m] : ramps.accelMs[m];
+
+        long value = modbusTCP.holdingRegisterRead(reg);
+        if (value == ms) continue;
+        if (value < 0 || value > RAMP_MAX_MS) {
+            Serial.print(F("Ramp time motor idx ")); Serial.print(m);
+            Serial.println(F(" refused (out of range)"));
+            modbusTCP.holdingRegisterWrite(reg, ms);
+        } else {
+            ms = (uint16_t)value;
+        }
+    }
+    applyRamps();
+}
+
+/** Motor number (1-6, 8) of a motor index, as the HMI shows it. */
+uint16_t motorNumber(int idx) {
+    return idx == MOTOR_8_IDX ? 8 : idx + 1;
+}
+
+/** Publish the start order (motor numbers) and step delays. */
+void pushStartSequenceToRegisters() {
+    for (int k = 0; k < NUM_MOTORS; k++)
+        modbusTCP.holdingRegisterWrite(Reg::START_ORDER_BASE + k, motorNumber(startSeq.order[k]));
+    for (int k = 0; k < NUM_MOTORS - 1; k++)
+        modbusTCP.holdingRegisterWrite(Reg::START_DELAY_BASE + k, startSeq.delayMs[k]);
+}
+
+/** Apply an edited start sequence.  The order is taken only as a whole
+ *  and only if it names each motor exactly once; a delay above
+ *  START_STEP_MAX_MS is refused.  Refused registers are restored. */
+void pullStartSequenceFromRegisters() {
+    uint8_t  order[NUM_MOTORS];
+    uint16_t seen = 0;
+    bool     valid = true;
+    for (int k = 0; k < NUM_MOTORS; k++) {
+        long n   = modbusTCP.holdingRegisterRead(Reg::START_ORDER_BASE + k);
+        int  idx = n == 8 ? MOTOR_8_IDX : (n >= 1 && n <= 6 ? (int)n - 1 : -1);
+        if (idx < 0 || (seen & (1u << idx))) { valid = false; break; }
+        seen    |= 1u << idx;
+        order[k] = (uint8_t)idx;
+    }
+    if (valid) {
+        for (int k = 0; k < NUM_MOTORS; k++) startSeq.order[k] = order[k];
+    } else {
+        Serial.println(F("Start order refused (each motor 1-6, 8 exactly once)"));
+    }
+
+    for (int k = 0; k < NUM_MOTORS - 1; k++) {
+        long ms = modbusTCP.holdingRegisterRead(Reg::START_DELAY_BASE + k);
+        if (ms >= 0 && ms <= START_STEP_MAX_MS) startSeq.delayMs[k] = (uint16_t)ms;
+        else Serial.println(F("Start step delay refused (out of range)"));
+    }
+    pushStartSequenceToRegisters();
+}
+
+/** Set the selected tray time factor from the photo-eye: the mean
+ *  interval measured since the run / profile started.  Needs
+ *  AUTOCAL_MIN_COUNTS pulses.  The tray-time section is saved and the
+ *  new factor ×1000 published in Reg::AUTOCAL_RESULT (0 = refused).
+ *  @return false if refused */
+bool autoCalibrateTrayTime() {
+    modbusTCP.holdingRegisterWrite(Reg::AUTOCAL_RESULT, 0);
+    bool running = currentState == STATE_RUN1 || currentState == STATE_RUN2;
+    if (!running || rateCounts < AUTOCAL_MIN_COUNTS) {
+        Serial.println(F("Auto-calibration refused: too few photo-eye counts this run"));
+        return false;
+    }
 
-    for (int t = 0; t < NUM_TRAYS; t++)
-        for (int s = 0; s < NUM_SPEEDS; s++)
-            calib.trayTimeFactors[t][s] =
-                modbusTCP.holdingRegisterRead(
-                    Reg::TRAY_TIME_BASE + t * NUM_SPEEDS + s) / 1000.0f;
+    uint32_t elapsedMs = millis() - rateStartMs;
+    long value = (long)((elapsedMs + rateCounts / 2) / rateCounts);   // ms per plant
+    int  slot  = Reg::MOTOR_FACTORS_COUNT + (traySelected - 1) * NUM_SPEEDS + (speedSelected - 1);
+    if (!calibValueValid(slot, value)) {
+        Serial.print(F("Auto-calibration refused: ")); Serial.print(value);
+        Serial.println(F(" ms per plant out of range"));
+        return false;
+    }
 
-    for (int t = 0; t < NUM_TRAYS; t++)
-        for (int s = 0; s < NUM_SPEEDS; s++)
-            calib.trayMotor8Factors[t][s] =
-                modbusTCP.holdingRegisterRead(
-                    Reg::TRAY_M8_BASE + t * NUM_SPEEDS + s) / 1000.0f;
+    int reg;
+    calibSlot(slot, reg) = value / 1000.0f;
+    SOFT_FLOAT_OPS(2);
+    calibRegs[slot] = (uint16_t)value;
+    modbusTCP.holdingRegisterWrite(reg, (uint16_t)value);
+    markProfilesDirty(slot);
+    buildProfiles();
+    setMotorSpeeds();
+    saveCalibSection(CALSEC_TRAY_TIME);
 
-    // Re-apply motor speeds if currently running
-    if (speedSelected >= 1 && traySelected >= 1) setMotorSpeeds();
+    modbusTCP.holdingRegisterWrite(Reg::AUTOCAL_RESULT, (uint16_t)value);
+    Serial.print(F("Auto-calibrated tray time: ")); Serial.print(value);
+    Serial.println(F(" ms per plant"));
+    return true;
 }
 
 // =====================================================================
 //  FLASH PERSISTENCE
 // =====================================================================
 
+/** CRC-32 (IEEE 802.3, reflected), bitwise — only used on save/boot. */
+uint32_t crc32Update(uint32_t crc, const void* data, size_t length) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    while (length--) {
+        crc ^= *p++;
+        for (int k = 0; k < 8; k++)
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+    }
+    return ~crc;
+}
+
+/** Where a section's payload lives in the RAM calibration. */
+void calibSectionData(CalibSection sec, uint8_t*& data, uint16_t& length) {
+    switch (sec) {
+    case CALSEC_MOTOR:
+        data = reinterpret_cast<uint8_t*>(calib.motorFactors);
+        length = sizeof(calib.motorFactors);      break;
+    case CALSEC_TRAY_TIME:
+        data = reinterpret_cast<uint8_t*>(calib.trayTimeFactors);
+        length = sizeof(calib.trayTimeFactors);   break;
+    case CALSEC_TRAY_M8:
+        data = reinterpret_cast<uint8_t*>(calib.trayMotor8Factors);
+        length = sizeof(calib.trayMotor8Factors); break;
+    case CALSEC_FILTER:
+        data = reinterpret_cast<uint8_t*>(&inputFilter);
+        length = sizeof(inputFilter);             break;
+    case CALSEC_RAMP:
+        data = reinterpret_cast<uint8_t*>(&ramps);
+        length = sizeof(ramps);                   break;
+    case CALSEC_START:
+        data = reinterpret_cast<uint8_t*>(&startSeq);
+        length = sizeof(startSeq);                break;
+    default:
+        data = reinterpret_cast<uint8_t*>(&calib.waitTime);
+        length = sizeof(calib.waitTime);          break;
+    }
+}
+
+static_assert(sizeof(CalibRecordHeader) + sizeof(CalibrationData::motorFactors)
+              <= FLASH_ROW_BYTES, "calibration section must fit one flash row");
+
+/** Load the newest valid copy of one section into calib.
+ *  Returns false (calib untouched) if neither copy is valid. */
+bool loadCalibSection(CalibSection sec) {
+    uint8_t* data;
+    uint16_t length;
+    calibSectionData(sec, data, length);
+
+    uint8_t row[FLASH_ROW_BYTES];
+    int     best = -1;
+    bool    anyWritten = false;
+
+    for (int copy = 0; copy < 2; copy++) {
+        calibStore.read(calibStoreData + (sec * 2 + copy) * FLASH_ROW_BYTES,
+                        row, FLASH_ROW_BYTES);
+        CalibRecordHeader h;
+        memcpy(&h, row, sizeof(h));
+        if (h.magic != CALIB_STORE_MAGIC) continue;
+        anyWritten = true;
+
+        if (h.schema != CALIB_SCHEMA_VERSION || h.section != sec || h.length != length)
+            continue;
+        uint32_t crc = crc32Update(0, row, offsetof(CalibRecordHeader, crc));
+        crc = crc32Update(crc, row + sizeof(h), length);
+        if (crc != h.crc) {
+            Serial.print(F("Calibration section ")); Serial.print(sec);
+            Serial.print(F(" copy ")); Serial.print(copy);
+            Serial.println(F(" failed CRC — ignored"));
+            continue;
+        }
+
+        if (best < 0 || h.sequence > calibSeq[sec]) {
+            best           = copy;
+            calibSeq[sec]  = h.sequence;
+            calibCrc[sec]  = h.crc;
+            memcpy(data, row + sizeof(h), length);
+        }
+    }
+
+    calibCopy[sec] = best;
+    if (best < 0 && anyWritten) {
+        Serial.print(F("Calibration section ")); Serial.print(sec);
+        Serial.println(F(" has no valid copy"));
+    }
+    return best >= 0;
+}
+
+/** Commit one section to the row not holding its live copy.  Skipped
+ *  when the content matches what is already stored.  Returns true if
+ *  flash was written. */
+bool saveCalibSection(CalibSection sec) {
+    uint8_t* data;
+    uint16_t length;
+    calibSectionData(sec, data, length);
+
+    uint8_t row[FLASH_ROW_BYTES];
+    CalibRecordHeader h = {};
+    h.magic    = CALIB_STORE_MAGIC;
+    h.schema   = CALIB_SCHEMA_VERSION;
+    h.section  = sec;
+    h.sequence = calibSeq[sec] + 1;
+    h.length   = length;
+
+    // Unchanged payload → nothing to do (CRC ignoring the sequence)
+    CalibRecordHeader live = h;
+    live.sequence = calibSeq[sec];
+    uint32_t liveCrc = crc32Update(0, &live, offsetof(CalibRecordHeader, crc));
+    liveCrc = crc32Update(liveCrc, data, length);
+    if (calibCopy[sec] >= 0 && liveCrc == calibCrc[sec]) return false;
+
+    h.crc = crc32Update(crc32Update(0, &h, offsetof(CalibRecordHeader, crc)), data, length);
+    memcpy(row, &h, sizeof(h));
+    memcpy(row + sizeof(h), data, length);
+
+    int copy = calibCopy[sec] == 0 ? 1 : 0;
+    const uint8_t* dst = calibStoreData + (sec * 2 + copy) * FLASH_ROW_BYTES;
+    calibStore.erase(dst, FLASH_ROW_BYTES);
+    calibStore.write(dst, row, sizeof(h) + length);
+
+    calibCopy[sec] = copy;
+    calibSeq[sec]  = h.sequence;
+    calibCrc[sec]  = h.crc;
+    return true;
+}
+
 void loadCalibration() {
-    CalibrationData stored = flashCalib.read();
-    if (stored.magic == CALIB_MAGIC) {
-        calib = stored;
+    // Factory defaults first; every valid section then overrides its part
+    loadFactoryDefaults(calib);
+    loadFilterDefaults(inputFilter);
+    loadRampDefaults(ramps);
+    loadStartDefaults(startSeq);
+
+    int loaded = 0;
+    for (int sec = 0; sec < NUM_CALSEC; sec++) {
+        if (loadCalibSection(static_cast<CalibSection>(sec))) loaded++;
+    }
+
+    if (loaded == NUM_CALSEC) {
         Serial.println(F("Calibration loaded from flash"));
-    } else {
-        loadFactoryDefaults(calib);
-        Serial.println(F("No saved calibration — using factory defaults"));
+        return;
     }
+    if (loaded > 0) {
+        Serial.print(F("Calibration: ")); Serial.print(NUM_CALSEC - loaded);
+        Serial.println(F(" section(s) missing — factory defaults used for them"));
+        return;
+    }
+    Serial.println(F("No saved calibration — using factory defaults"));
 }
 
+/** Commit every section whose content changed. */
 void saveCalibration() {
-    calib.magic = CALIB_MAGIC;
-    flashCalib.write(calib);
-    Serial.println(F("Calibration saved to flash"));
+    int written = 0;
+    for (int sec = 0; sec < NUM_CALSEC; sec++) {
+        if (saveCalibSection(static_cast<CalibSection>(sec))) written++;
+    }
+    Serial.print(F("Calibration saved to flash (")); Serial.print(written);
+    Serial.println(F(" section(s) written)"));
 }
 
+/** Read journal slot; true if it holds a complete, valid record. */
+bool readCounterRecord(int slot, CounterRecord& rec) {
+    counterJournal.read(counterJournalData + slot * sizeof(CounterRecord),
+                        &rec, sizeof(rec));
+    return rec.magic == COUNTER_REC_MAGIC && rec.check == counterRecordCheck(rec);
+}
+
+/** Rebuild totalCounter from the journal: the valid record with the
+ *  highest sequence wins, and writing resumes in the slot after it. */
 void loadCounter() {
-    CounterData cd = flashCounter.read();
-    if (cd.magic == CALIB_MAGIC) {
-        totalCounter = cd.totalCounter;
-        Serial.print(F("Total counter loaded: ")); Serial.println(totalCounter);
-    } else {
-        totalCounter = 0;
-        Serial.println(F("No saved counter — starting at 0"));
+    int      newest = -1;
+    uint32_t newestSeq = 0;
+    CounterRecord rec;
+
+    for (int slot = 0; slot < COUNTER_JOURNAL_RECS; slot++) {
+        if (readCounterRecord(slot, rec) && (newest < 0 || rec.sequence > newestSeq)) {
+            newest    = slot;
+            newestSeq = rec.sequence;
+            totalCounter = rec.totalCounter;
+        }
     }
+
+    if (newest >= 0) {
+        journalNext = (newest + 1) % COUNTER_JOURNAL_RECS;
+        journalSeq  = newestSeq + 1;
+        Serial.print(F("Total counter loaded: ")); Serial.print(totalCounter);
+        Serial.print(F(" (journal seq ")); Serial.print(newestSeq); Serial.println(F(")"));
+        return;
+    }
+
+    journalNext  = 0;
+    journalSeq   = 1;
+    totalCounter = 0;
+    Serial.println(F("No saved counter — starting at 0"));
 }
 
+/** Append totalCounter to the journal.  Only the first record of a row
+ *  costs a row erase; the others program one page. */
 void saveCounter() {
-    CounterData cd;
-    cd.magic        = CALIB_MAGIC;
-    cd.totalCounter = totalCounter;
-    flashCounter.write(cd);
+    int slot = journalNext;
+
+    if (slot % COUNTER_RECS_PER_ROW == 0) {
+        counterJournal.erase(counterJournalData + slot * sizeof(CounterRecord),
+                             FLASH_ROW_BYTES);
+    } else {
+        // A torn write (power loss) can leave a half-programmed slot
+        // behind; skip anything that is not blank.
+        CounterRecord probe;
+        while (slot % COUNTER_RECS_PER_ROW != 0) {
+            counterJournal.read(counterJournalData + slot * sizeof(CounterRecord),
+                                &probe, sizeof(probe));
+            if (probe.magic == 0xFFFFFFFFu && probe.check == 0xFFFFFFFFu) break;
+            slot = (slot + 1) % COUNTER_JOURNAL_RECS;
+        }
+        if (slot % COUNTER_RECS_PER_ROW == 0) {
+            counterJournal.erase(counterJournalData + slot * sizeof(CounterRecord),
+                                 FLASH_ROW_BYTES);
+        }
+    }
+
+    CounterRecord rec;
+    rec.magic        = COUNTER_REC_MAGIC;
+    rec.sequence     = journalSeq++;
+    rec.totalCounter = totalCounter;
+    rec.check        = counterRecordCheck(rec);
+    counterJournal.write(counterJournalData + slot * sizeof(CounterRecord),
+                         &rec, sizeof(rec));
+
+    journalNext = (slot + 1) % COUNTER_JOURNAL_RECS;
 }
 
 // =====================================================================
-//  PRODUCTION LOGGING  (Serial CSV — capture with terminal or logger)
+//  PRODUCTION LOGGING  (RAM ring drained over Modbus + Serial CSV)
 // =====================================================================
 
-void logProductionRun() {
-    if (currentCounter == 0) return;
-
-    // CSV: timestamp_ms, tray, speed, batchCount, totalCount
+/** Close the current production record.  A batch that ended
+ *  (delay done, HMI reset) is logged if it counted anything; a stop is
+ *  logged if a run was open.  The record goes into the RAM ring, is
+ *  queued for the flash journal and goes out over Serial as CSV. */
+void logProductionRun(StopReason reason) {
+    bool batchEnd = reason == STOP_REASON_DELAY_DONE || reason == STOP_REASON_HMI_RESET;
+    bool wasOpen  = runOpen;
+    runOpen = false;
+    if (batchEnd ? currentCounter == 0 : !wasOpen) return;
+
+    ProductionRecord r;
+    r.timestamp   = clockNow();
+    r.batchCount  = currentCounter;
+    r.totalCount  = totalCounter;
+    r.durationS   = wasOpen ? saturateU16((millis() - runStartMs) / 1000) : 0;
+    r.sequence    = logNextSeq;
+    r.tray        = (uint8_t)traySelected;
+    r.speed       = (uint8_t)speedSelected;
+    r.reason      = reason;
+    r.reserved    = 0;
+    appendLogRecord(r);
+    queueJournalEntry(JRN_RECORD, r);
+
+    // CSV: timestamp (clock seconds), tray, speed, batchCount, totalCount
     Serial.print(F("LOG,"));
-    Serial.print(millis());           Serial.print(',');
+    Serial.print(r.timestamp);        Serial.print(',');
     if (traySelected >= 1 && traySelected <= NUM_TRAYS)
         Serial.print(TRAY_NAMES[traySelected - 1]);
     else
@@ -757,3 +2100,201 @@ void logProductionRun() {
     Serial.print(currentCounter);     Serial.print(',');
     Serial.println(totalCounter);
 }
+
+/** Add a record to the RAM ring; when it is full the oldest
+ *  unacknowledged record is overwritten and counted as lost. */
+void appendLogRecord(const ProductionRecord& r) {
+    if (logCount == LOG_DEPTH) {
+        logHead = (logHead + 1) % LOG_DEPTH;
+        logCount--;
+        if (logLost < 0xFFFF) logLost++;
+    }
+    prodLog[(logHead + logCount) % LOG_DEPTH] = r;
+    logCount++;
+    logNextSeq     = r.sequence == 0xFFFF ? 1 : r.sequence + 1;
+    logWindowDirty = true;
+}
+
+/** Drop the record with this sequence and every older one.
+ *  @return false if no such record is in the ring (nothing dropped) */
+bool dropLogThrough(uint16_t sequence) {
+    for (uint8_t k = 0; k < logCount; k++) {
+        if (prodLog[(logHead + k) % LOG_DEPTH].sequence != sequence) continue;
+        logHead   = (logHead + k + 1) % LOG_DEPTH;
+        logCount -= k + 1;
+        logWindowDirty = true;
+        return true;
+    }
+    return false;
+}
+
+/** Take an acknowledgement and refresh the readout window.  An ack
+ *  names the last record the client stored; it and all older records
+ *  are dropped, and the ack is journalled so they stay dropped after a
+ *  reboot.  A sequence not in the ring (repeat or stale ack) is
+ *  ignored, so a retried ack never drops a record twice. */
+void serviceProductionLog() {
+    uint16_t ack = (uint16_t)modbusTCP.holdingRegisterRead(Reg::LOG_ACK);
+    if (ack != 0) {
+        modbusTCP.holdingRegisterWrite(Reg::LOG_ACK, 0);
+        if (dropLogThrough(ack)) {
+            ProductionRecord marker = {};
+            marker.sequence = ack;
+            queueJournalEntry(JRN_ACK, marker);
+        }
+    }
+    if (logWindowDirty) publishLogWindow();
+}
+/** Rewrite the window with the oldest unacknowledged records. */
+void publishLogWindow() {
+    logWindowDirty = false;
+    for (int w = 0; w < LOG_WINDOW_RECORDS; w++) {
+        uint16_t words[Reg::LOG_RECORD_WORDS] = {};
+        if (w < logCount) {
+            const ProductionRecord& r = prodLog[(logHead + w) % LOG_DEPTH];
+            words[0] = r.sequence;
+            words[1] = (uint16_t)(r.timestamp & 0xFFFF);
+            words[2] = (uint16_t)(r.timestamp >> 16);
+            words[3] = (uint16_t)(r.tray << 8 | r.speed);
+            words[4] = r.reason;
+            words[5] = (uint16_t)(r.batchCount & 0xFFFF);
+            words[6] = (uint16_t)(r.batchCount >> 16);
+            words[7] = (uint16_t)(r.totalCount & 0xFFFF);
+            words[8] = (uint16_t)(r.totalCount >> 16);
+            words[9] = r.durationS;
+        }
+        int base = Reg::LOG_WINDOW_BASE + w * Reg::LOG_RECORD_WORDS;
+        for (int i = 0; i < Reg::LOG_RECORD_WORDS; i++)
+            modbusTCP.holdingRegisterWrite(base + i, words[i]);
+    }
+    modbusTCP.holdingRegisterWrite(Reg::LOG_PENDING, logCount);
+    modbusTCP.holdingRegisterWrite(Reg::LOG_CURSOR, logCount ? prodLog[logHead].sequence : 0);
+    modbusTCP.holdingRegisterWrite(Reg::LOG_LOST, logLost);
+}
+
+// =====================================================================
+//  PRODUCTION JOURNAL  (flash, committed in scan slack)
+// =====================================================================
+
+/** Queue an entry for commitJournalEntry().  Consecutive acks collapse
+ *  into the newest one; a full queue drops the entry (the RAM ring
+ *  still has the record). */
+void queueJournalEntry(JournalKind kind, const ProductionRecord& r) {
+    if (kind == JRN_ACK && jrnQueued && jrnQueue[jrnQueued - 1].kind == JRN_ACK) {
+        jrnQueue[jrnQueued - 1].record = r;
+        return;
+    }
+    if (jrnQueued == JOURNAL_QUEUE) {
+        Serial.println(F("Production journal queue full — entry not saved"));
+        return;
+    }
+    ProdJournalEntry& e = jrnQueue[jrnQueued++];
+    e.kind   = kind;
+    e.record = r;
+}
+
+/** Program the oldest queued entry into the next journal slot.  Only
+ *  the first entry of a row costs a row erase.  Called from the scan
+ *  slack when a worst-case commit (JOURNAL_COMMIT_US) still fits. */
+void commitJournalEntry() {
+    int slot = jrnNext;
+
+    if (slot % PROD_ENTRIES_PER_ROW != 0) {
+        // Skip anything a torn write left behind
+        ProdJournalEntry probe;
+        while (slot % PROD_ENTRIES_PER_ROW != 0) {
+            prodJournal.read(prodJournalData + slot * sizeof(ProdJournalEntry),
+                             &probe, sizeof(probe));
+            if (probe.sequence == 0xFFFFFFFFu && probe.crc == 0xFFFFFFFFu) break;
+            slot = (slot + 1) % PROD_JOURNAL_ENTRIES;
+        }
+    }
+    if (slot % PROD_ENTRIES_PER_ROW == 0) {
+        evictJournalRow(slot);
+        prodJournal.erase(prodJournalData + slot * sizeof(ProdJournalEntry),
+                          FLASH_ROW_BYTES);
+    }
+
+    ProdJournalEntry e = jrnQueue[0];
+    e.sequence = jrnSeq++;
+    e.reserved = 0;
+    e.lost     = logLost;
+    e.crc = crc32Update(0, &e, offsetof(ProdJournalEntry, crc));
+    prodJournal.write(prodJournalData + slot * sizeof(ProdJournalEntry), &e, sizeof(e));
+
+    jrnNext = (slot + 1) % PROD_JOURNAL_ENTRIES;
+    jrnQueued--;
+    for (uint8_t i = 0; i < jrnQueued; i++) jrnQueue[i] = jrnQueue[i + 1];
+}
+
+/** Unacknowledged records in the row about to be erased lose their
+ *  flash copy.  Drop them from the RAM ring too and count them as
+ *  lost, so the log reads the same before and after a reboot.  (With
+ *  LOG_DEPTH well under the journal size the ring has normally shed
+ *  them already.) */
+void evictJournalRow(int first) {
+    ProdJournalEntry e;
+    for (int slot = first; slot < first + PROD_ENTRIES_PER_ROW; slot++) {
+        if (!readJournalEntry(slot, e) || e.kind != JRN_RECORD) continue;
+        uint8_t before = logCount;
+        if (!dropLogThrough(e.record.sequence)) continue;
+        uint16_t n = before - logCount;
+        logLost = logLost > 0xFFFF - n ? 0xFFFF : logLost + n;
+    }
+}
+
+bool readJournalEntry(int slot, ProdJournalEntry& e) {
+    prodJournal.read(prodJournalData + slot * sizeof(ProdJournalEntry), &e, sizeof(e));
+    return e.sequence != 0xFFFFFFFFu &&
+           e.crc == crc32Update(0, &e, offsetof(ProdJournalEntry, crc));
+}
+
+/** Rebuild the RAM log from the journal: replay records and acks
+ *  oldest-first, leaving the records no poller has acknowledged. */
+void loadProductionJournal() {
+    logHead = logCount = 0;
+    logLost = 0;
+    logNextSeq = 1;
+    jrnQueued = 0;
+
+    int      newest    = -1;
+    uint32_t newestSeq = 0;
+    ProdJournalEntry e;
+    for (int slot = 0; slot < PROD_JOURNAL_ENTRIES; slot++) {
+        if (readJournalEntry(slot, e) && (newest < 0 || e.sequence > newestSeq)) {
+            newest    = slot;
+            newestSeq = e.sequence;
+        }
+    }
+    if (newest < 0) {
+        jrnNext = 0;
+        jrnSeq  = 1;
+        Serial.println(F("Production journal empty"));
+        return;
+    }
+
+    // The slot after the newest entry holds the oldest surviving one
+    bool seqSeen = false;
+    for (int k = 1; k <= PROD_JOURNAL_ENTRIES; k++) {
+        int slot = (newest + k) % PROD_JOURNAL_ENTRIES;
+        if (!readJournalEntry(slot, e)) continue;
+        if (e.kind == JRN_RECORD) {
+            appendLogRecord(e.record);
+        } else if (e.kind == JRN_ACK) {
+            dropLogThrough(e.record.sequence);
+            // The ack may outlive its record: numbering still continues
+            // past it, so the HMI never sees an acknowledged number again
+            uint16_t next = e.record.sequence == 0xFFFF ? 1 : e.record.sequence + 1;
+            if (!seqSeen || (int16_t)(next - logNextSeq) > 0) logNextSeq = next;
+        }
+        seqSeen = true;
+    }
+    // Replay only sees the surviving rows; the newest entry knows them all
+    readJournalEntry(newest, e);
+    logLost = e.lost;
+    jrnNext = (newest + 1) % PROD_JOURNAL_ENTRIES;
+    jrnSeq  = newestSeq + 1;
+    logWindowDirty = true;
+    Serial.print(F("Production journal: ")); Serial.print(logCount);
+    Serial.println(F(" unsent record(s) restored"));
+}